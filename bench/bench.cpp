@@ -0,0 +1,264 @@
+// Headless benchmarks
+// Each scenario runs the game against the off-screen window for a fixed number
+// of steps from a fixed seed, in a child process so the rng streams, profile
+// zones and peak memory all start fresh. Results are written to stdout as JSON.
+//
+//   bench              run every scenario
+//   bench NAME ...     run the named scenarios
+//   bench --list       list the scenarios
+
+#include "game.h"
+#include "gameloop.h"
+#include "profiler.h"
+#include "window.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Scenario {
+  const char* name;
+  recti world;       // worldBounds
+  int mobs;          // -1 scales with the world's area, as the game does
+  int steps;         // fixed steps, two per world tick
+  int killEvery = 0; // world ticks between kill storms, 0 for none
+  int killCount = 0; // mobs killed (and respawned) per storm
+};
+
+static recti centred(int width, int height){
+  return {-width / 2, height / 2, width, height};
+}
+
+static const std::vector<Scenario> scenarios {
+  {"default",     centred(128, 48),      -1,     4000},
+  {"mobs_1k",     centred(512, 256),     1000,   2000},
+  {"mobs_10k",    centred(1024, 1024),   10000,  1000},
+  {"mobs_100k",   centred(4096, 2048),   100000, 200},
+  {"large_world", centred(8192, 4096),   -1,     400},
+  {"kill_storm",  centred(256, 128),     1000,   2000, 4, 50},
+};
+
+static const uint64_t Seed = 3;
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start){
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static long peakRssKb(){
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; // kilobytes on Linux
+}
+
+// Queues killCount kills of random mobs (never the player), and as many spawns
+// so the population holds; the kills splatter blood and leave bones
+static void killStorm(Game& game, int killCount){
+  auto& r = rng(RngStream::Default);
+  auto& mobs = game.mobs.values();
+  ident playerMob = game.entities[game.player].mob;
+  std::vector<ident> picked;
+  for (int tries = 0; tries < killCount * 4 && (int) picked.size() < killCount && !mobs.empty(); tries++){
+    const Mob& mob = mobs[randInt(r, 0, (int) mobs.size() - 1)];
+    if (mob.id == playerMob || mob.health <= 0) continue;
+    if (std::find(picked.begin(), picked.end(), mob.id) != picked.end()) continue;
+    picked.push_back(mob.id);
+  }
+
+  const auto& b = game.worldBounds;
+  for (ident id: picked){
+    game.queueEvent(EvKillMob {id});
+    vec2i pos {randInt(r, b.left, b.left + b.width - 1), randInt(r, b.top - b.height + 1, b.top)};
+    game.queueEvent(EvSpawnMob {choose(r, {MobType::Rabbit, MobType::OrcStrong, MobType::Snake}), pos});
+  }
+}
+
+static void runScenario(const Scenario& sc, FILE* out){
+  seedRandom(Seed);
+  Profiler::setEnabled(true);
+
+  auto setupStart = Clock::now();
+  std::unique_ptr<Window> window { new Window };
+  std::unique_ptr<Game> game { new Game {*window} };
+  game->worldBounds = sc.world;
+  game->setup(sc.mobs);
+  double setupMs = msSince(setupStart);
+  long setupRssKb = peakRssKb();
+  int startMobs = (int) game->mobs.values().size();
+
+  GameLoop::Config config;
+  config.headless = true;
+  config.renderEvery = 2; // once per world tick
+  config.maxSteps = sc.steps;
+  GameLoop loop {*window, *game, config};
+
+  // Storms are queued between frames, so they're handled at the next world tick
+  auto start = Clock::now();
+  int lastStorm = 0;
+  while (loop.frame()){
+    if (sc.killEvery > 0 && game->worldTick() - lastStorm >= sc.killEvery){
+      lastStorm = game->worldTick();
+      killStorm(*game, sc.killCount);
+    }
+  }
+  double runMs = msSince(start);
+
+  const auto& lod = game->mobSystem().lodTotals();
+  fprintf(out, "  {\"name\": \"%s\", \"world\": [%d, %d], \"seed\": %llu,\n", sc.name, sc.world.width, sc.world.height, (unsigned long long) Seed);
+  fprintf(out, "   \"steps\": %lld, \"world_ticks\": %d, \"setup_ms\": %.3f, \"run_ms\": %.3f,\n",
+          (long long) loop.steps(), game->worldTick(), setupMs, runMs);
+  fprintf(out, "   \"steps_per_sec\": %.1f, \"ticks_per_sec\": %.1f,\n",
+          loop.steps() / (runMs / 1000), game->worldTick() / (runMs / 1000));
+  fprintf(out, "   \"mobs\": {\"start\": %d, \"end\": %d, \"near_updates\": %d, \"far_updates\": %d, \"deferred\": %d},\n",
+          startMobs, (int) game->mobs.values().size(), lod.near, lod.far, lod.deferred);
+  fprintf(out, "   \"entities\": %d, \"sprites\": %d,\n", (int) game->entities.values().size(), (int) game->sprites.values().size());
+  fprintf(out, "   \"memory\": {\"setup_peak_rss_kb\": %ld, \"peak_rss_kb\": %ld},\n", setupRssKb, peakRssKb());
+
+  // Nested zones include their children, e.g. update holds mobs and events
+  fprintf(out, "   \"zones\": {");
+  const auto& zones = Profiler::zones();
+  for (size_t i = 0; i < zones.size(); i++){
+    const auto* zone = zones[i];
+    fprintf(out, "%s\n     \"%s\": {\"total_ms\": %.3f, \"avg_us\": %.3f, \"worst_us\": %.3f}", i ? "," : "",
+            zone->name(), zone->totalAll() / 1e6, zone->averageAll() / 1e3, zone->worstAll() / 1e3);
+  }
+  fprintf(out, "\n   }}");
+}
+
+// An Rng that can count the draws between an earlier copy of itself and now
+class CountingRng: public Rng {
+public:
+  using Rng::Rng;
+
+  uint64_t drawsSince(CountingRng earlier) const {
+    uint64_t draws = 0;
+    while (!std::equal(s_, s_ + 4, earlier.s_)){
+      earlier.next();
+      draws++;
+    }
+    return draws;
+  }
+};
+
+// sampleRange (geometric skips, or a roll per element above p = 0.5) against a
+// die rolled per element, at the game's rates: dirt (1/61), terrain (1/7) and
+// blood splatter (4/5)
+static void runSampling(FILE* out){
+  const int64_t n = 1 << 20;
+  struct Rate { const char* use; int sides; bool hitOnZero; double p; };
+  const Rate rates[] {
+    {"dirt",    61, true,  1.0 / 61},
+    {"terrain", 7,  true,  1.0 / 7},
+    {"splatter", 5, false, 4.0 / 5},
+  };
+
+  fprintf(out, "  {\"name\": \"sampling\", \"elements\": %lld, \"rates\": [", (long long) n);
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++){
+    const Rate& rate = rates[i];
+
+    CountingRng r {Seed};
+    CountingRng before = r;
+    int64_t rollHits = 0;
+    auto start = Clock::now();
+    for (int64_t j = 0; j < n; j++){
+      if ((randInt(r, 0, rate.sides - 1) == 0) == rate.hitOnZero) rollHits++;
+    }
+    double rollMs = msSince(start);
+    uint64_t rollDraws = r.drawsSince(before);
+
+    before = r;
+    int64_t skipHits = 0;
+    start = Clock::now();
+    sampleRange(r, n, rate.p, [&](int64_t){ skipHits++; });
+    double skipMs = msSince(start);
+    uint64_t skipDraws = r.drawsSince(before);
+
+    fprintf(out, "%s\n    {\"use\": \"%s\", \"p\": %.6f,", i ? "," : "", rate.use, rate.p);
+    fprintf(out, " \"per_element\": {\"draws\": %llu, \"hits\": %lld, \"ms\": %.3f},", (unsigned long long) rollDraws, (long long) rollHits, rollMs);
+    fprintf(out, " \"sample_range\": {\"draws\": %llu, \"hits\": %lld, \"ms\": %.3f}}", (unsigned long long) skipDraws, (long long) skipHits, skipMs);
+  }
+  fprintf(out, "\n  ]}");
+}
+
+// Runs f in a child with stdout sent to /dev/null (the off-screen game prints
+// its log there) and returns what it wrote to out, empty if it failed
+template <typename F>
+static std::string isolated(F&& f){
+  int fds[2];
+  if (pipe(fds) != 0) return "";
+  fflush(stdout);
+
+  pid_t pid = fork();
+  if (pid == 0){
+    close(fds[0]);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    FILE* out = fdopen(fds[1], "w");
+    f(out);
+    fclose(out);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  std::string result;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) result.append(buffer, n);
+  close(fds[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return "";
+  return result;
+}
+
+int main(int argc, const char* argv[]){
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "--list") == 0){
+      for (const auto& sc: scenarios) printf("%s\n", sc.name);
+      printf("sampling\n");
+      return 0;
+    }
+    names.push_back(argv[i]);
+  }
+  auto wanted = [&](const char* name){
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+  };
+
+  bool failed = false;
+  std::vector<std::string> results;
+  auto run = [&](const char* name, std::function<void(FILE*)> f){
+    if (!wanted(name)) return;
+    fprintf(stderr, "%s...\n", name);
+    std::string result = isolated(f);
+    if (result.empty()){
+      fprintf(stderr, "%s failed\n", name);
+      failed = true;
+    }
+    else results.push_back(result);
+  };
+
+  for (const auto& sc: scenarios){
+    run(sc.name, [&](FILE* out){ runScenario(sc, out); });
+  }
+  run("sampling", runSampling);
+
+  printf("{\"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++){
+    printf("%s%s\n", results[i].c_str(), i + 1 < results.size() ? "," : "");
+  }
+  printf("]}\n");
+  return failed ? 1 : 0;
+}
@@ -54,11 +54,6 @@ static void bytebuffer_resize(struct bytebuffer *b, int len) {
 	b->len = len;
 }
 
-static void bytebuffer_flush(struct bytebuffer *b, int fd) {
-	write(fd, b->buf, b->len);
-	bytebuffer_clear(b);
-}
-
 static void bytebuffer_truncate(struct bytebuffer *b, int n) {
 	if (n <= 0)
 		return;
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -11,9 +12,14 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <wchar.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "termbox.h"
 
 #include "bytebuffer.inl"
@@ -34,9 +40,24 @@ static struct termios orig_tios;
 
 static struct cellbuf back_buffer;
 static struct cellbuf front_buffer;
+
+/* rows of the back buffer changed since the last present */
+static unsigned char *dirty_rows;
 static struct bytebuffer output_buffer;
 static struct bytebuffer input_buffer;
 
+/* the output thread writes write_buffer while output_buffer fills up */
+static struct writer {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct bytebuffer buffer;
+	int running;
+	int busy;
+	int quit;
+	struct timespec handed_over;
+} writer = {.mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
 static int termw = -1;
 static int termh = -1;
 
@@ -48,6 +69,15 @@ static int winch_fds[2];
 
 static int lastx = LAST_COORD_INIT;
 static int lasty = LAST_COORD_INIT;
+
+#define LAST_ATTR_INIT 0xFFFF
+static uint16_t lastfg = LAST_ATTR_INIT;
+static uint16_t lastbg = LAST_ATTR_INIT;
+
+static struct tb_stats stats;
+static uint32_t out_cells;
+static uint32_t out_moves;
+static uint32_t out_attrs;
 static int cursor_x = -1;
 static int cursor_y = -1;
 
@@ -60,12 +90,20 @@ static void write_sgr(uint16_t fg, uint16_t bg);
 static void cellbuf_init(struct cellbuf *buf, int width, int height);
 static void cellbuf_resize(struct cellbuf *buf, int width, int height);
 static void cellbuf_clear(struct cellbuf *buf);
+static void cellbuf_shift(struct cellbuf *buf, int top, int bottom, int dx, int dy);
+static void cellbuf_invalidate(struct cellbuf *buf, int x, int y, int w, int h);
 static void cellbuf_free(struct cellbuf *buf);
+static void resize_dirty_rows(int height);
+static int find_diff(const struct tb_cell *a, const struct tb_cell *b, int x, int n);
 
+static void flush_output(void);
+static int hand_over_output(void);
 static void update_size(void);
 static void update_term_size(void);
 static void send_attr(uint16_t fg, uint16_t bg);
 static void send_char(int x, int y, uint32_t c);
+static void move_cursor(int x, int y);
+static int can_rewrite(int x, int y, int n);
 static void send_clear(void);
 static void sigwinch_handler(int xxx);
 static int wait_fill_event(struct tb_event *event, struct timeval *timeout);
@@ -73,6 +111,24 @@ static int wait_fill_event(struct tb_event *event, struct timeval *timeout);
 /* may happen in a different thread */
 static volatile int buffer_size_change_request;
 
+static int convertnum(uint32_t num, char* buf) {
+	int i, l = 0;
+	int ch;
+	do {
+		buf[l++] = '0' + (num % 10);
+		num /= 10;
+	} while (num);
+	for(i = 0; i < l / 2; i++) {
+		ch = buf[i];
+		buf[i] = buf[l - 1 - i];
+		buf[l - 1 - i] = ch;
+	}
+	return l;
+}
+
+#define WRITE_LITERAL(X) bytebuffer_append(&output_buffer, (X), sizeof(X)-1)
+#define WRITE_INT(X) bytebuffer_append(&output_buffer, buf, convertnum((X), buf))
+
 /* -------------------------------------------------------- */
 
 int tb_init_fd(int inout_)
@@ -126,6 +182,7 @@ int tb_init_fd(int inout_)
 	cellbuf_init(&front_buffer, termw, termh);
 	cellbuf_clear(&back_buffer);
 	cellbuf_clear(&front_buffer);
+	resize_dirty_rows(termh);
 
 	return 0;
 }
@@ -152,7 +209,8 @@ void tb_shutdown(void)
 	bytebuffer_puts(&output_buffer, funcs[T_EXIT_CA]);
 	bytebuffer_puts(&output_buffer, funcs[T_EXIT_KEYPAD]);
 	bytebuffer_puts(&output_buffer, funcs[T_EXIT_MOUSE]);
-	bytebuffer_flush(&output_buffer, inout);
+	tb_set_async_output(0);
+	flush_output();
 	tcsetattr(inout, TCSAFLUSH, &orig_tios);
 
 	shutdown_term();
@@ -162,16 +220,31 @@ void tb_shutdown(void)
 
 	cellbuf_free(&back_buffer);
 	cellbuf_free(&front_buffer);
+	free(dirty_rows);
+	dirty_rows = 0;
 	bytebuffer_free(&output_buffer);
 	bytebuffer_free(&input_buffer);
 	termw = termh = -1;
 }
 
-void tb_present(void)
+int tb_present(void)
 {
-	int x,y,w,i;
+	int x,y,w,i,gap;
 	struct tb_cell *back, *front;
 
+	/* the front buffer must match what has been written, so don't diff
+	 * against it while the last frame is still going out */
+	if (writer.running) {
+		int busy;
+		pthread_mutex_lock(&writer.mutex);
+		busy = writer.busy;
+		pthread_mutex_unlock(&writer.mutex);
+		if (busy) {
+			stats.skipped++;
+			return -1;
+		}
+	}
+
 	/* invalidate cursor position */
 	lastx = LAST_COORD_INIT;
 	lasty = LAST_COORD_INIT;
@@ -182,14 +255,34 @@ void tb_present(void)
 	}
 
 	for (y = 0; y < front_buffer.height; ++y) {
+		if (!dirty_rows[y])
+			continue;
+		dirty_rows[y] = 0;
+		if (memcmp(&CELL(&back_buffer, 0, y), &CELL(&front_buffer, 0, y),
+			   sizeof(struct tb_cell) * front_buffer.width) == 0)
+			continue;
+
 		for (x = 0; x < front_buffer.width; ) {
+			x = find_diff(&CELL(&back_buffer, 0, y), &CELL(&front_buffer, 0, y), x, front_buffer.width);
+			if (x >= front_buffer.width)
+				break;
+			/* the right half of a wide character is never sent */
+			if (x > 0 && wcwidth(CELL(&back_buffer, x - 1, y).ch) > 1) {
+				++x;
+				continue;
+			}
 			back = &CELL(&back_buffer, x, y);
 			front = &CELL(&front_buffer, x, y);
 			w = wcwidth(back->ch);
 			if (w < 1) w = 1;
-			if (memcmp(back, front, sizeof(struct tb_cell)) == 0) {
-				x += w;
-				continue;
+			/* a short unchanged gap since the last write is cheaper to
+			 * write over again than to move across */
+			if (y == lasty && lastx != LAST_COORD_INIT) {
+				gap = x - lastx - 1;
+				if (gap > 0 && gap <= 3 && can_rewrite(lastx + 1, y, gap)) {
+					for (i = lastx + 1; i < x; ++i)
+						send_char(i, y, CELL(&back_buffer, i, y).ch);
+				}
 			}
 			memcpy(front, back, sizeof(struct tb_cell));
 			send_attr(back->fg, back->bg);
@@ -212,7 +305,134 @@ void tb_present(void)
 	}
 	if (!IS_CURSOR_HIDDEN(cursor_x, cursor_y))
 		write_cursor(cursor_x, cursor_y);
-	bytebuffer_flush(&output_buffer, inout);
+
+	stats.last_bytes = output_buffer.len;
+	stats.last_cells = out_cells;
+	stats.last_moves = out_moves;
+	stats.last_attrs = out_attrs;
+	stats.total_bytes += output_buffer.len;
+	stats.presents++;
+	out_cells = out_moves = out_attrs = 0;
+
+	if (!hand_over_output())
+		flush_output();
+	return 0;
+}
+
+void tb_get_stats(struct tb_stats *s)
+{
+	pthread_mutex_lock(&writer.mutex);
+	*s = stats;
+	pthread_mutex_unlock(&writer.mutex);
+}
+
+static uint32_t elapsed_us(const struct timespec *from)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((now.tv_sec - from->tv_sec) * 1000000 + (now.tv_nsec - from->tv_nsec) / 1000);
+}
+
+static void write_all(int fd, const char *buf, int len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static void *writer_main(void *arg)
+{
+	(void) arg;
+	pthread_mutex_lock(&writer.mutex);
+	while (1) {
+		while (!writer.busy && !writer.quit)
+			pthread_cond_wait(&writer.cond, &writer.mutex);
+		if (!writer.busy)
+			break;
+
+		pthread_mutex_unlock(&writer.mutex);
+		write_all(inout, writer.buffer.buf, writer.buffer.len);
+		bytebuffer_clear(&writer.buffer);
+		pthread_mutex_lock(&writer.mutex);
+
+		stats.last_write_us = elapsed_us(&writer.handed_over);
+		if (stats.last_write_us > stats.max_write_us)
+			stats.max_write_us = stats.last_write_us;
+		writer.busy = 0;
+		pthread_cond_broadcast(&writer.cond);
+	}
+	pthread_mutex_unlock(&writer.mutex);
+	return 0;
+}
+
+int tb_set_async_output(int enable)
+{
+	if (enable && !writer.running) {
+		bytebuffer_init(&writer.buffer, 32 * 1024);
+		writer.busy = 0;
+		writer.quit = 0;
+		if (pthread_create(&writer.thread, 0, writer_main, 0) != 0) {
+			bytebuffer_free(&writer.buffer);
+			return -1;
+		}
+		writer.running = 1;
+	} else if (!enable && writer.running) {
+		pthread_mutex_lock(&writer.mutex);
+		writer.quit = 1;
+		pthread_cond_broadcast(&writer.cond);
+		pthread_mutex_unlock(&writer.mutex);
+		pthread_join(writer.thread, 0);
+		bytebuffer_free(&writer.buffer);
+		writer.running = 0;
+	}
+	return 0;
+}
+
+/* gives output_buffer to the writer thread, returns 0 if there isn't one */
+static int hand_over_output(void)
+{
+	struct bytebuffer tmp;
+	if (!writer.running)
+		return 0;
+
+	pthread_mutex_lock(&writer.mutex);
+	while (writer.busy)
+		pthread_cond_wait(&writer.cond, &writer.mutex);
+	tmp = writer.buffer;
+	writer.buffer = output_buffer;
+	output_buffer = tmp;
+	clock_gettime(CLOCK_MONOTONIC, &writer.handed_over);
+	writer.busy = 1;
+	pthread_cond_broadcast(&writer.cond);
+	pthread_mutex_unlock(&writer.mutex);
+	return 1;
+}
+
+/* writes output_buffer out now, after anything the writer thread still has */
+static void flush_output(void)
+{
+	struct timespec start;
+	if (writer.running) {
+		pthread_mutex_lock(&writer.mutex);
+		while (writer.busy)
+			pthread_cond_wait(&writer.cond, &writer.mutex);
+		pthread_mutex_unlock(&writer.mutex);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	write_all(inout, output_buffer.buf, output_buffer.len);
+	bytebuffer_clear(&output_buffer);
+	if (!writer.running) {
+		stats.last_write_us = elapsed_us(&start);
+		if (stats.last_write_us > stats.max_write_us)
+			stats.max_write_us = stats.last_write_us;
+	}
 }
 
 void tb_set_cursor(int cx, int cy)
@@ -236,6 +456,7 @@ void tb_put_cell(int x, int y, const struct tb_cell *cell)
 	if ((unsigned)y >= (unsigned)back_buffer.height)
 		return;
 	CELL(&back_buffer, x, y) = *cell;
+	dirty_rows[y] = 1;
 }
 
 void tb_change_cell(int x, int y, uint32_t ch, uint16_t fg, uint16_t bg)
@@ -268,6 +489,7 @@ void tb_blit(int x, int y, int w, int h, const struct tb_cell *cells)
 
 	int sy;
 	struct tb_cell *dst = &CELL(&back_buffer, x, y);
+	tb_mark_rows(y, y + hh);
 	const struct tb_cell *src = cells + yo * w + xo;
 	size_t size = sizeof(struct tb_cell) * ww;
 
@@ -278,11 +500,87 @@ void tb_blit(int x, int y, int w, int h, const struct tb_cell *cells)
 	}
 }
 
+int tb_scroll(int top, int bottom, int dx, int dy)
+{
+	char buf[32];
+	int y, n;
+	int w = front_buffer.width;
+
+	if (top < 0)
+		top = 0;
+	if (bottom > front_buffer.height)
+		bottom = front_buffer.height;
+	if (buffer_size_change_request)
+		return -1;
+	if (top >= bottom || (dx == 0 && dy == 0))
+		return 0;
+
+	cellbuf_shift(&back_buffer, top, bottom, dx, dy);
+	tb_mark_rows(top, bottom);
+	if (abs(dx) >= w || abs(dy) >= bottom - top) {
+		cellbuf_invalidate(&front_buffer, 0, top, w, bottom - top);
+		return 0;
+	}
+	cellbuf_shift(&front_buffer, top, bottom, dx, dy);
+
+	if (dy != 0) {
+		/* scrolling only touches the region between the margins */
+		WRITE_LITERAL("\033[");
+		WRITE_INT(top + 1);
+		WRITE_LITERAL(";");
+		WRITE_INT(bottom);
+		WRITE_LITERAL("r");
+		if (dy < 0) {
+			write_cursor(0, bottom - 1);
+			for (n = 0; n < -dy; ++n)
+				WRITE_LITERAL("\n");
+			cellbuf_invalidate(&front_buffer, 0, bottom + dy, w, -dy);
+		} else {
+			write_cursor(0, top);
+			for (n = 0; n < dy; ++n)
+				WRITE_LITERAL("\033M");
+			cellbuf_invalidate(&front_buffer, 0, top, w, dy);
+		}
+		WRITE_LITERAL("\033[r");
+	}
+
+	if (dx != 0) {
+		for (y = top; y < bottom; ++y) {
+			write_cursor(0, y);
+			WRITE_LITERAL("\033[");
+			WRITE_INT(abs(dx));
+			if (dx < 0)
+				WRITE_LITERAL("P");
+			else
+				WRITE_LITERAL("@");
+		}
+		if (dx < 0)
+			cellbuf_invalidate(&front_buffer, w + dx, top, -dx, bottom - top);
+		else
+			cellbuf_invalidate(&front_buffer, 0, top, dx, bottom - top);
+	}
+
+	/* the margins reset homes the cursor */
+	lastx = LAST_COORD_INIT;
+	lasty = LAST_COORD_INIT;
+	return 0;
+}
+
 struct tb_cell *tb_cell_buffer(void)
 {
 	return back_buffer.cells;
 }
 
+void tb_mark_rows(int top, int bottom)
+{
+	if (top < 0)
+		top = 0;
+	if (bottom > back_buffer.height)
+		bottom = back_buffer.height;
+	if (top < bottom)
+		memset(dirty_rows + top, 1, bottom - top);
+}
+
 int tb_poll_event(struct tb_event *event)
 {
 	return wait_fill_event(event, 0);
@@ -292,10 +590,18 @@ int tb_peek_event(struct tb_event *event, int timeout)
 {
 	struct timeval tv;
 	tv.tv_sec = timeout / 1000;
-  tv.tv_usec = (__darwin_suseconds_t)((timeout - (tv.tv_sec * 1000)) * 1000);
+	tv.tv_usec = (suseconds_t)((timeout - (tv.tv_sec * 1000)) * 1000);
 	return wait_fill_event(event, &tv);
 }
 
+void tb_get_fds(int *input, int *resize)
+{
+	if (input)
+		*input = inout;
+	if (resize)
+		*resize = winch_fds[0];
+}
+
 int tb_width(void)
 {
 	return termw;
@@ -313,6 +619,7 @@ void tb_clear(void)
 		buffer_size_change_request = 0;
 	}
 	cellbuf_clear(&back_buffer);
+	tb_mark_rows(0, back_buffer.height);
 }
 
 int tb_select_input_mode(int mode)
@@ -329,10 +636,10 @@ int tb_select_input_mode(int mode)
 		inputmode = mode;
 		if (mode&TB_INPUT_MOUSE) {
 			bytebuffer_puts(&output_buffer, funcs[T_ENTER_MOUSE]);
-			bytebuffer_flush(&output_buffer, inout);
+			flush_output();
 		} else {
 			bytebuffer_puts(&output_buffer, funcs[T_EXIT_MOUSE]);
-			bytebuffer_flush(&output_buffer, inout);
+			flush_output();
 		}
 	}
 	return inputmode;
@@ -353,26 +660,9 @@ void tb_set_clear_attributes(uint16_t fg, uint16_t bg)
 
 /* -------------------------------------------------------- */
 
-static int convertnum(uint32_t num, char* buf) {
-	int i, l = 0;
-	int ch;
-	do {
-		buf[l++] = '0' + (num % 10);
-		num /= 10;
-	} while (num);
-	for(i = 0; i < l / 2; i++) {
-		ch = buf[i];
-		buf[i] = buf[l - 1 - i];
-		buf[l - 1 - i] = ch;
-	}
-	return l;
-}
-
-#define WRITE_LITERAL(X) bytebuffer_append(&output_buffer, (X), sizeof(X)-1)
-#define WRITE_INT(X) bytebuffer_append(&output_buffer, buf, convertnum((X), buf))
-
 static void write_cursor(int x, int y) {
 	char buf[32];
+	out_moves++;
 	WRITE_LITERAL("\033[");
 	WRITE_INT(y+1);
 	WRITE_LITERAL(";");
@@ -468,11 +758,72 @@ static void cellbuf_clear(struct cellbuf *buf)
 	}
 }
 
+static void cellbuf_shift(struct cellbuf *buf, int top, int bottom, int dx, int dy)
+{
+	int y;
+	int w = buf->width - abs(dx);
+	int srcx = (dx < 0) ? -dx : 0;
+	int dstx = (dx > 0) ? dx : 0;
+
+	if (w <= 0 || bottom - top <= abs(dy))
+		return;
+
+	if (dy > 0) {
+		for (y = bottom - 1; y >= top + dy; --y)
+			memmove(&CELL(buf, dstx, y), &CELL(buf, srcx, y - dy), sizeof(struct tb_cell) * w);
+	} else {
+		for (y = top; y < bottom + dy; ++y)
+			memmove(&CELL(buf, dstx, y), &CELL(buf, srcx, y - dy), sizeof(struct tb_cell) * w);
+	}
+}
+
+/* marks cells as unknown so tb_present() redraws them whatever the back buffer holds */
+static void cellbuf_invalidate(struct cellbuf *buf, int x, int y, int w, int h)
+{
+	int i, j;
+	for (j = y; j < y + h; ++j) {
+		for (i = x; i < x + w; ++i) {
+			CELL(buf, i, j).ch = ' ';
+			CELL(buf, i, j).fg = 0xFFFF;
+			CELL(buf, i, j).bg = 0xFFFF;
+		}
+	}
+}
+
 static void cellbuf_free(struct cellbuf *buf)
 {
 	free(buf->cells);
 }
 
+/* every row starts out changed */
+static void resize_dirty_rows(int height)
+{
+	free(dirty_rows);
+	dirty_rows = (unsigned char*)malloc(height > 0 ? height : 1);
+	assert(dirty_rows);
+	memset(dirty_rows, 1, height);
+}
+
+/* returns the first cell in [x, n) that differs between rows a and b, or n */
+static int find_diff(const struct tb_cell *a, const struct tb_cell *b, int x, int n)
+{
+#ifdef __SSE2__
+	/* two cells per compare */
+	for (; x + 2 <= n; x += 2) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+		if (mask != 0xFFFF)
+			return ((mask & 0xFF) != 0xFF) ? x : x + 1;
+	}
+#endif
+	for (; x < n; ++x) {
+		if (memcmp(a + x, b + x, sizeof(struct tb_cell)) != 0)
+			return x;
+	}
+	return n;
+}
+
 static void get_term_size(int *w, int *h)
 {
 	struct winsize sz;
@@ -495,67 +846,255 @@ static void update_term_size(void)
 	termh = sz.ws_row;
 }
 
-static void send_attr(uint16_t fg, uint16_t bg)
+static void map_colors(uint16_t fg, uint16_t bg, uint16_t *fgcol, uint16_t *bgcol)
 {
-#define LAST_ATTR_INIT 0xFFFF
-	static uint16_t lastfg = LAST_ATTR_INIT, lastbg = LAST_ATTR_INIT;
-	if (fg != lastfg || bg != lastbg) {
-		bytebuffer_puts(&output_buffer, funcs[T_SGR0]);
+	switch (outputmode) {
+	case TB_OUTPUT_256:
+		*fgcol = fg & 0xFF;
+		*bgcol = bg & 0xFF;
+		break;
 
-		uint16_t fgcol;
-		uint16_t bgcol;
+	case TB_OUTPUT_216:
+		*fgcol = fg & 0xFF; if (*fgcol > 215) *fgcol = 7;
+		*bgcol = bg & 0xFF; if (*bgcol > 215) *bgcol = 0;
+		*fgcol += 0x10;
+		*bgcol += 0x10;
+		break;
 
-		switch (outputmode) {
-		case TB_OUTPUT_256:
-			fgcol = fg & 0xFF;
-			bgcol = bg & 0xFF;
-			break;
+	case TB_OUTPUT_GRAYSCALE:
+		*fgcol = fg & 0xFF; if (*fgcol > 23) *fgcol = 23;
+		*bgcol = bg & 0xFF; if (*bgcol > 23) *bgcol = 0;
+		*fgcol += 0xe8;
+		*bgcol += 0xe8;
+		break;
 
-		case TB_OUTPUT_216:
-			fgcol = fg & 0xFF; if (fgcol > 215) fgcol = 7;
-			bgcol = bg & 0xFF; if (bgcol > 215) bgcol = 0;
-			fgcol += 0x10;
-			bgcol += 0x10;
-			break;
+	case TB_OUTPUT_NORMAL:
+	default:
+		*fgcol = fg & 0x0F;
+		*bgcol = bg & 0x0F;
+	}
+}
 
-		case TB_OUTPUT_GRAYSCALE:
-			fgcol = fg & 0xFF; if (fgcol > 23) fgcol = 23;
-			bgcol = bg & 0xFF; if (bgcol > 23) bgcol = 0;
-			fgcol += 0xe8;
-			bgcol += 0xe8;
-			break;
+#define STYLE_BOLD      1
+#define STYLE_BLINK     2
+#define STYLE_UNDERLINE 4
+#define STYLE_REVERSE   8
 
-		case TB_OUTPUT_NORMAL:
-		default:
-			fgcol = fg & 0x0F;
-			bgcol = bg & 0x0F;
-		}
+static int attr_style(uint16_t fg, uint16_t bg)
+{
+	int style = 0;
+	if (fg & TB_BOLD)
+		style |= STYLE_BOLD;
+	if (bg & TB_BOLD)
+		style |= STYLE_BLINK;
+	if (fg & TB_UNDERLINE)
+		style |= STYLE_UNDERLINE;
+	if ((fg & TB_REVERSE) || (bg & TB_REVERSE))
+		style |= STYLE_REVERSE;
+	return style;
+}
+
+static void write_color(int base, uint16_t col)
+{
+	char buf[32];
+	if (col == TB_DEFAULT) {
+		WRITE_INT(base + 9);
+	} else if (outputmode == TB_OUTPUT_NORMAL) {
+		WRITE_INT(base + col - 1);
+	} else {
+		WRITE_INT(base + 8);
+		WRITE_LITERAL(";5;");
+		WRITE_INT(col);
+	}
+}
+
+static void send_attr(uint16_t fg, uint16_t bg)
+{
+	uint16_t fgcol, bgcol, lastfgcol, lastbgcol;
+	int style, laststyle, sep = 0;
+
+	if (fg == lastfg && bg == lastbg)
+		return;
+
+	map_colors(fg, bg, &fgcol, &bgcol);
+	style = attr_style(fg, bg);
+	laststyle = attr_style(lastfg, lastbg);
+	map_colors(lastfg, lastbg, &lastfgcol, &lastbgcol);
+
+	/* different attributes can still look the same on the terminal, and
+	 * an empty "\033[m" would reset everything */
+	if (lastfg != LAST_ATTR_INIT && style == laststyle &&
+	    fgcol == lastfgcol && bgcol == lastbgcol) {
+		lastfg = fg;
+		lastbg = bg;
+		return;
+	}
+	out_attrs++;
 
-		if (fg & TB_BOLD)
+	if (lastfg == LAST_ATTR_INIT || (laststyle & ~style)) {
+		/* attributes can only be turned off all at once */
+		bytebuffer_puts(&output_buffer, funcs[T_SGR0]);
+
+		if (style & STYLE_BOLD)
 			bytebuffer_puts(&output_buffer, funcs[T_BOLD]);
-		if (bg & TB_BOLD)
+		if (style & STYLE_BLINK)
 			bytebuffer_puts(&output_buffer, funcs[T_BLINK]);
-		if (fg & TB_UNDERLINE)
+		if (style & STYLE_UNDERLINE)
 			bytebuffer_puts(&output_buffer, funcs[T_UNDERLINE]);
-		if ((fg & TB_REVERSE) || (bg & TB_REVERSE))
+		if (style & STYLE_REVERSE)
 			bytebuffer_puts(&output_buffer, funcs[T_REVERSE]);
 
 		write_sgr(fgcol, bgcol);
-
-		lastfg = fg;
-		lastbg = bg;
+	} else {
+		/* otherwise send only what changed, in one sequence */
+		WRITE_LITERAL("\033[");
+		if (style & ~laststyle & STYLE_BOLD) {
+			WRITE_LITERAL("1");
+			sep = 1;
+		}
+		if (style & ~laststyle & STYLE_BLINK) {
+			if (sep) WRITE_LITERAL(";");
+			WRITE_LITERAL("5");
+			sep = 1;
+		}
+		if (style & ~laststyle & STYLE_UNDERLINE) {
+			if (sep) WRITE_LITERAL(";");
+			WRITE_LITERAL("4");
+			sep = 1;
+		}
+		if (style & ~laststyle & STYLE_REVERSE) {
+			if (sep) WRITE_LITERAL(";");
+			WRITE_LITERAL("7");
+			sep = 1;
+		}
+		if (fgcol != lastfgcol) {
+			if (sep) WRITE_LITERAL(";");
+			write_color(30, fgcol);
+			sep = 1;
+		}
+		if (bgcol != lastbgcol) {
+			if (sep) WRITE_LITERAL(";");
+			write_color(40, bgcol);
+		}
+		WRITE_LITERAL("m");
 	}
+
+	lastfg = fg;
+	lastbg = bg;
 }
 
 static void send_char(int x, int y, uint32_t c)
 {
 	char buf[7];
 	int bw = tb_utf8_unicode_to_char(buf, c);
-	if (x-1 != lastx || y != lasty)
-		write_cursor(x, y);
-	lastx = x; lasty = y;
+	int cw = wcwidth(c);
+	if (cw < 1) cw = 1;
+	move_cursor(x, y);
 	if(!c) buf[0] = ' '; // replace 0 with whitespace
 	bytebuffer_append(&output_buffer, buf, bw);
+	out_cells++;
+
+	/* lastx + 1 is where the terminal's cursor is now, except after
+	 * writing the last column, where terminals differ on wrapping */
+	lastx = x + cw - 1; lasty = y;
+	if (lastx >= front_buffer.width - 1)
+		lastx = lasty = LAST_COORD_INIT;
+}
+
+static int num_len(int n)
+{
+	int l = 1;
+	while (n >= 10) {
+		n /= 10;
+		l++;
+	}
+	return l;
+}
+
+/* bytes in "\033[nC", where n can be left out when 1 */
+static int forward_len(int n)
+{
+	if (n <= 0)
+		return 0;
+	return (n == 1) ? 3 : 3 + num_len(n);
+}
+
+static void write_forward(int n)
+{
+	char buf[32];
+	if (n <= 0)
+		return;
+	WRITE_LITERAL("\033[");
+	if (n > 1)
+		WRITE_INT(n);
+	WRITE_LITERAL("C");
+}
+
+/* moves the cursor to (x, y) with whichever of an absolute move, a move
+ * forward along the row, line feeds or a carriage return and line feeds
+ * takes the fewest bytes */
+static void move_cursor(int x, int y)
+{
+	int cx = lastx + 1;
+	int dy = y - lasty;
+	int n, cost, best = 0;
+	int best_cost = 4 + num_len(y + 1) + num_len(x + 1);
+
+	if (lastx == LAST_COORD_INIT || lasty == LAST_COORD_INIT) {
+		write_cursor(x, y);
+		return;
+	}
+	if (dy == 0 && x == cx)
+		return;
+
+	if (dy == 0 && x > cx) {
+		cost = forward_len(x - cx);
+		if (cost < best_cost) { best = 1; best_cost = cost; }
+	}
+	if (dy > 0 && x >= cx) {
+		cost = dy + forward_len(x - cx);
+		if (cost < best_cost) { best = 2; best_cost = cost; }
+	}
+	if (dy > 0) {
+		cost = 1 + dy + forward_len(x);
+		if (cost < best_cost) { best = 3; best_cost = cost; }
+	}
+
+	switch (best) {
+	case 0:
+		write_cursor(x, y);
+		return;
+	case 1:
+		write_forward(x - cx);
+		break;
+	case 2:
+		for (n = 0; n < dy; ++n)
+			WRITE_LITERAL("\n");
+		write_forward(x - cx);
+		break;
+	case 3:
+		WRITE_LITERAL("\r");
+		for (n = 0; n < dy; ++n)
+			WRITE_LITERAL("\n");
+		write_forward(x);
+		break;
+	}
+	out_moves++;
+}
+
+/* true if the n cells from (x, y) are already on screen as plain
+ * characters in the current attributes, so sending them again is harmless */
+static int can_rewrite(int x, int y, int n)
+{
+	int i;
+	for (i = x; i < x + n; ++i) {
+		struct tb_cell *c = &CELL(&front_buffer, i, y);
+		if (c->ch < 0x20 || c->ch >= 0x7f || c->fg != lastfg || c->bg != lastbg)
+			return 0;
+		if (memcmp(c, &CELL(&back_buffer, i, y), sizeof(struct tb_cell)) != 0)
+			return 0;
+	}
+	return 1;
 }
 
 static void send_clear(void)
@@ -564,7 +1103,7 @@ static void send_clear(void)
 	bytebuffer_puts(&output_buffer, funcs[T_CLEAR_SCREEN]);
 	if (!IS_CURSOR_HIDDEN(cursor_x, cursor_y))
 		write_cursor(cursor_x, cursor_y);
-	bytebuffer_flush(&output_buffer, inout);
+	flush_output();
 
 	/* we need to invalidate cursor position too and these two vars are
 	 * used only for simple cursor positioning optimization, cursor
@@ -588,6 +1127,7 @@ static void update_size(void)
 	cellbuf_resize(&back_buffer, termw, termh);
 	cellbuf_resize(&front_buffer, termw, termh);
 	cellbuf_clear(&front_buffer);
+	resize_dirty_rows(termh);
 	send_clear();
 }
 
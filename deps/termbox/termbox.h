@@ -196,8 +196,11 @@ SO_IMPORT int tb_height(void);
 SO_IMPORT void tb_clear(void);
 SO_IMPORT void tb_set_clear_attributes(uint16_t fg, uint16_t bg);
 
-/* Synchronizes the internal back buffer with the terminal. */
-SO_IMPORT void tb_present(void);
+/* Synchronizes the internal back buffer with the terminal. Returns 0 once the
+ * frame is written (or handed to the output thread), or -1 if it was skipped
+ * because the output thread is still writing the last one.
+ */
+SO_IMPORT int tb_present(void);
 
 #define TB_HIDE_CURSOR -1
 
@@ -221,13 +224,60 @@ SO_IMPORT void tb_change_cell(int x, int y, uint32_t ch, uint16_t fg, uint16_t b
  */
 SO_IMPORT void tb_blit(int x, int y, int w, int h, const struct tb_cell *cells);
 
+/* Moves what is on the terminal in rows [top, bottom) by 'dx' columns and 'dy'
+ * rows (positive is right and down) without redrawing it: vertically with a
+ * scroll region and index/reverse index, horizontally with insert/delete
+ * character on every row of the region, which moves whole rows. The front and
+ * back buffers are moved to match. Cells moved in from outside the region
+ * keep stale contents in the back buffer and are redrawn by the next
+ * tb_present() once the caller has filled them in. Returns 0, or -1 if a
+ * resize is pending, in which case nothing is moved and the caller should
+ * redraw the whole screen.
+ */
+SO_IMPORT int tb_scroll(int top, int bottom, int dx, int dy);
+
+/* Output statistics. The 'last_*' fields describe the output of the most
+ * recent tb_present(), including anything queued since the one before it
+ * (e.g. by tb_scroll()). The totals accumulate from tb_init().
+ */
+struct tb_stats {
+	uint32_t last_bytes;
+	uint32_t last_cells; /* characters sent */
+	uint32_t last_moves; /* cursor movement sequences */
+	uint32_t last_attrs; /* attribute (SGR) sequences */
+	uint64_t total_bytes;
+	uint64_t presents;
+	uint64_t skipped;    /* presents dropped while the writer was busy */
+	uint32_t last_write_us; /* time to write the last frame out */
+	uint32_t max_write_us;
+};
+
+SO_IMPORT void tb_get_stats(struct tb_stats *stats);
+
+/* Moves writing to the terminal onto a separate thread, so a slow terminal
+ * doesn't stall the caller. tb_present() then hands the frame over and
+ * returns at once. While the previous frame is still being written a present
+ * is skipped without touching the front buffer, so its changes go out with
+ * the next one. Returns 0 on success, or -1 if the thread couldn't be started.
+ * Passing 0 waits for pending output and stops the thread.
+ */
+SO_IMPORT int tb_set_async_output(int enable);
+
 /* Returns a pointer to internal cell back buffer. You can get its dimensions
  * using tb_width() and tb_height() functions. The pointer stays valid as long
  * as no tb_clear() and tb_present() calls are made. The buffer is
  * one-dimensional buffer containing lines of cells starting from the top.
+ *
+ * tb_present() only looks at rows that have changed since the last present,
+ * so rows written through this pointer must be marked with tb_mark_rows().
  */
 SO_IMPORT struct tb_cell *tb_cell_buffer(void);
 
+/* Marks rows [top, bottom) of the back buffer as changed. tb_put_cell(),
+ * tb_change_cell(), tb_blit() and tb_clear() do this themselves.
+ */
+SO_IMPORT void tb_mark_rows(int top, int bottom);
+
 #define TB_INPUT_CURRENT 0 /* 000 */
 #define TB_INPUT_ESC     1 /* 001 */
 #define TB_INPUT_ALT     2 /* 010 */
@@ -309,6 +359,13 @@ SO_IMPORT int tb_peek_event(struct tb_event *event, int timeout);
  */
 SO_IMPORT int tb_poll_event(struct tb_event *event);
 
+/* Returns the descriptors tb_peek_event() waits on: the terminal, and a pipe
+ * that becomes readable when the terminal is resized. Lets the caller wait on
+ * input together with its own deadlines, then drain it with
+ * tb_peek_event(&event, 0).
+ */
+SO_IMPORT void tb_get_fds(int *input, int *resize);
+
 /* Utility utf8 functions. */
 #define TB_EOF -1
 SO_IMPORT int tb_utf8_char_length(char c);
@@ -231,10 +231,15 @@ var RootWindowFuncs = {
         bg_color = bg_color || this.current_background;
         fg_color = fg_color || this.current_foreground;
         var index = this.index(cx, cy);
+        var color = this.color_memory[index];
+        if (this.char_memory[index] === char && color.foreground === fg_color &&
+            color.background === bg_color)
+            return;
 
         this.char_memory[index] = char;
-        this.color_memory[index].foreground = fg_color;
-        this.color_memory[index].background = bg_color;
+        color.foreground = fg_color;
+        color.background = bg_color;
+        this.mark_dirty(cx, cy);
     }),
 
     /**
@@ -281,10 +286,30 @@ var RootWindowFuncs = {
         if (!this.in_window(cx, cy))
             return;
 
+        RootWindowFuncs.set_ch.apply(this, [' ', cx, cy]);
+    }),
+
+    /**
+     * Marks a cell as needing to be repainted by the next refresh().
+     */
+    'mark_dirty': (function(cx, cy) {
         var index = this.index(cx, cy);
-        this.char_memory[index] = ' ';
-        this.color_memory[index].foreground = this.current_foreground;
-        this.color_memory[index].background = this.current_background;
+        if (this.dirty[index])
+            return;
+
+        this.dirty[index] = 1;
+        this.dirty_min[cy] = Math.min(this.dirty_min[cy], cx);
+        this.dirty_max[cy] = Math.max(this.dirty_max[cy], cx + 1);
+    }),
+
+    /**
+     * Marks the whole screen as needing to be repainted, e.g. after the canvas
+     * has been cleared or resized behind our back.
+     */
+    'touch': (function() {
+        this.dirty.fill(1);
+        this.dirty_min.fill(0);
+        this.dirty_max.fill(this.width);
     }),
 
     /**
@@ -320,27 +345,117 @@ var RootWindowFuncs = {
     }),
 
     /**
-     * Draws the screen. 
-     * 
-     * Note that this uses the simplest method possible - that is, it draws all cells,
-     * regardless of whether they have been modified since the last call. ncurses
-     * is a bit smarter, and I'll have to see if there is enough of a performance
-     * difference to justify the additional complexity of adding bookeeping to draw
-     * only the differences.
+     * Draws a packed cell buffer of the given size, laid out the way the game's
+     * Window keeps it: two 32-bit words per cell, the character code and then
+     * fg | (bg << 16), where each colour is an index into palette. Only cells
+     * that differ from the previously presented buffer are stored and redrawn;
+     * a change of size redraws everything. The screen is refreshed afterwards.
+     */
+    'present_cells': (function(cells, width, height, palette) {
+        var full = this.last_cells === null ||
+                   this.last_width !== width || this.last_height !== height;
+        if (full) {
+            this.last_cells = new Uint32Array(width * height * 2);
+            this.last_width = width;
+            this.last_height = height;
+        }
+
+        var last = this.last_cells;
+        var rows = Math.min(height, this.height);
+        var cols = Math.min(width, this.width);
+        this.cells_presented = 0;
+        for (var row = rows - 1; row >= 0; row--) {
+            for (var col = 0; col < cols; col++) {
+                var i = 2 * (col + width * row);
+                var ch = cells[i], attr = cells[i + 1];
+                if (!full && last[i] === ch && last[i + 1] === attr)
+                    continue;
+                last[i] = ch;
+                last[i + 1] = attr;
+
+                RootWindowFuncs.set_ch.apply(this, [String.fromCharCode(ch), col, row,
+                    palette[attr >>> 16] || palette[0], palette[attr & 0xFFFF] || palette[0]]);
+                this.cells_presented++;
+            }
+        }
+
+        RootWindowFuncs.refresh.apply(this);
+    }),
+
+    /**
+     * Draws the cells modified since the last refresh.
+     *
+     * Dirty cells are painted in two passes. Backgrounds first, one fillRect per
+     * run of adjacent dirty cells sharing a background colour. Then the
+     * characters, grouped by foreground colour so fillStyle changes once per
+     * colour rather than once per cell. Drawing all characters after all
+     * backgrounds, and going from the bottom to the top, means characters like
+     * the comma that stick below their cell don't get chopped off by the cell
+     * underneath them.
+     *
+     * The counters in this.stats describe the last refresh.
      */
     'refresh': (function() {
         var context = this.get_context();
         context.font = this.font_size + 'px ' + this.font;
         context.textAlign = 'center';
 
-        // Note that we go from the bottom to the top, since there are characters
-        // like the comma which will stick below the cell, and get chopped off by
-        // the bottom cell. Going from the bottom, we don't chop off those
-        // bottom pieces, since they get drawn over the bottom cell, which has already
-        // been rendered.
+        var stats = this.stats;
+        stats.cells = 0;
+        stats.runs = 0;
+        stats.glyphs = 0;
+        stats.colors = 0;
+
+        var text_offset = - this.aspect_y / 4;
+        var glyphs = {};
+        var fill = null;
         for (var row = this.height - 1; row >= 0; row--) {
-            for (var col = 0; col < this.width; col++)
-                RootWindowFuncs.refresh_cell.apply(this, [context, col, row]);
+            var x1 = this.dirty_max[row];
+            var col = this.dirty_min[row];
+            while (col < x1) {
+                var index = this.index(col, row);
+                if (!this.dirty[index]) {
+                    col++;
+                    continue;
+                }
+
+                // Extend the run over dirty cells with the same background
+                var background = this.color_memory[index].background;
+                var start = col;
+                do {
+                    this.dirty[index] = 0;
+                    var char = this.char_memory[index];
+                    if (char !== ' ') {
+                        var foreground = this.color_memory[index].foreground;
+                        (glyphs[foreground] = glyphs[foreground] || []).push(char, col, row);
+                    }
+                    col++;
+                    index++;
+                } while (col < x1 && this.dirty[index] &&
+                         this.color_memory[index].background === background);
+
+                if (fill !== background) {
+                    context.fillStyle = fill = background;
+                    stats.colors++;
+                }
+                context.fillRect(start * this.aspect_x, row * this.aspect_y,
+                                 (col - start) * this.aspect_x, this.aspect_y);
+                stats.cells += col - start;
+                stats.runs++;
+            }
+            this.dirty_min[row] = this.width;
+            this.dirty_max[row] = 0;
+        }
+
+        for (var color in glyphs) {
+            var list = glyphs[color];
+            context.fillStyle = color;
+            stats.colors++;
+            for (var i = 0; i < list.length; i += 3) {
+                context.fillText(list[i], (list[i + 1] + 0.5) * this.aspect_x,
+                                 (list[i + 2] + 1) * this.aspect_y + text_offset);
+            }
+            stats.glyphs += list.length / 3;
         }
     }),
 };
@@ -361,6 +476,21 @@ function RootWindow(canvas, width, height, font, font_size) {
     self.font = font || 'courier';
     self.font_size = font_size || Math.floor(canvas.height / (height * 1.1));
 
+    // The last buffer given to present_cells(), and how many cells it redrew
+    self.last_cells = null;
+    self.last_width = 0;
+    self.last_height = 0;
+    self.cells_presented = 0;
+
+    // Cells modified since the last refresh, with the dirty extent of each row
+    self.dirty = new Uint8Array(width * height);
+    self.dirty_min = new Int32Array(height);
+    self.dirty_max = new Int32Array(height);
+
+    // What the last refresh() painted: cells, background runs, characters,
+    // and fillStyle changes
+    self.stats = {'cells': 0, 'runs': 0, 'glyphs': 0, 'colors': 0};
+
     self.current_foreground = 'rgb(255,255,255)';
     self.current_background = 'rgb(0,0,0)';
 
@@ -387,6 +517,9 @@ function RootWindow(canvas, width, height, font, font_size) {
                 'background': 'rgb(0, 0, 0)'
             });
     }
+
+    // Nothing has been painted yet
+    RootWindowFuncs.touch.apply(self);
     return self;
 }
 
@@ -519,3 +652,12 @@ function Subwindow(parent_win, x, y, width, height)
 
     return self;
 }
+
+// Lets node load this file, e.g. to drive a RootWindow over a stub canvas
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = {
+        'CursesKey': CursesKey,
+        'RootWindow': RootWindow,
+        'Subwindow': Subwindow,
+    };
+}
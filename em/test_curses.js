@@ -0,0 +1,161 @@
+// Headless checks for curses.js's dirty-cell painting, run with: node em/test_curses.js
+// The canvas is a stub whose 2D context records every call.
+
+var assert = require('assert');
+var curses = require('./curses.js');
+
+function StubCanvas(width, height) {
+    var calls = [];
+    var context = {
+        'fillStyle': null,
+        'font': '',
+        'textAlign': '',
+        'fillRect': function(x, y, w, h) {
+            calls.push({'op': 'fillRect', 'style': this.fillStyle, 'x': x, 'y': y, 'w': w, 'h': h});
+        },
+        'fillText': function(text, x, y) {
+            calls.push({'op': 'fillText', 'style': this.fillStyle, 'text': text, 'x': x, 'y': y});
+        },
+    };
+    return {
+        'width': width,
+        'height': height,
+        'calls': calls,
+        'getContext': function() { return context; },
+    };
+}
+
+// A cols x rows window over a canvas with 10x20 pixel cells
+function setup(cols, rows) {
+    var canvas = StubCanvas(cols * 10, rows * 20);
+    var root = curses.RootWindow(canvas, cols, rows);
+    return {'canvas': canvas, 'root': root};
+}
+
+function ops(canvas, op) {
+    return canvas.calls.filter(function(c) { return c.op === op; });
+}
+
+var tests = {
+    'first refresh paints every cell, one run per row': function() {
+        var t = setup(8, 3);
+        t.root.refresh();
+        assert.strictEqual(t.root.stats.cells, 24);
+        assert.strictEqual(t.root.stats.runs, 3);
+        assert.strictEqual(t.root.stats.glyphs, 0); // all blank
+        var rects = ops(t.canvas, 'fillRect');
+        assert.deepStrictEqual(rects.map(function(r) { return [r.x, r.y, r.w, r.h]; }),
+                               [[0, 40, 80, 20], [0, 20, 80, 20], [0, 0, 80, 20]]); // bottom up
+    },
+
+    'a clean screen paints nothing': function() {
+        var t = setup(8, 3);
+        t.root.refresh();
+        t.canvas.calls.length = 0;
+        t.root.refresh();
+        assert.strictEqual(t.canvas.calls.length, 0);
+        assert.strictEqual(t.root.stats.cells, 0);
+    },
+
+    'rewriting a cell with the same contents does not dirty it': function() {
+        var t = setup(8, 3);
+        t.root.set_ch('x', 2, 1, 'blue', 'white');
+        t.root.refresh();
+        t.root.set_ch('x', 2, 1, 'blue', 'white');
+        assert.strictEqual(t.root.dirty[t.root.index(2, 1)], 0);
+        t.root.set_ch('y', 2, 1, 'blue', 'white');
+        assert.strictEqual(t.root.dirty[t.root.index(2, 1)], 1);
+    },
+
+    'adjacent dirty cells with one background share a run': function() {
+        var t = setup(8, 3);
+        t.root.refresh();
+        t.canvas.calls.length = 0;
+        t.root.set_ch('a', 2, 1, 'blue', 'white');
+        t.root.set_ch('b', 3, 1, 'blue', 'white');
+        t.root.set_ch('c', 4, 1, 'red', 'white');  // new background, new run
+        t.root.set_ch('d', 6, 1, 'red', 'white');  // gap, new run
+        t.root.refresh();
+
+        var rects = ops(t.canvas, 'fillRect');
+        assert.deepStrictEqual(rects.map(function(r) { return [r.style, r.x, r.w]; }),
+                               [['blue', 20, 20], ['red', 40, 10], ['red', 60, 10]]);
+        assert.strictEqual(t.root.stats.runs, 3);
+        assert.strictEqual(t.root.stats.cells, 4);
+        assert.strictEqual(t.root.stats.colors, 3); // blue, red, then white for every glyph
+
+        // Characters come after every background, grouped by colour
+        var texts = ops(t.canvas, 'fillText');
+        assert.deepStrictEqual(texts.map(function(c) { return c.text; }), ['a', 'b', 'c', 'd']);
+        var lastRect = t.canvas.calls.lastIndexOf(rects[rects.length - 1]);
+        assert.ok(t.canvas.calls.indexOf(texts[0]) > lastRect);
+    },
+
+    'refresh clears the dirty flags and row extents': function() {
+        var t = setup(8, 3);
+        t.root.set_ch('x', 5, 2, 'blue', 'white');
+        t.root.refresh();
+        assert.ok(t.root.dirty.every(function(d) { return d === 0; }));
+        assert.ok(t.root.dirty_min.every(function(x) { return x === 8; }));
+        assert.ok(t.root.dirty_max.every(function(x) { return x === 0; }));
+    },
+
+    'touch repaints everything': function() {
+        var t = setup(8, 3);
+        t.root.set_ch('x', 5, 2, 'blue', 'white');
+        t.root.refresh();
+        t.canvas.calls.length = 0;
+        t.root.touch();
+        t.root.refresh();
+        assert.strictEqual(t.root.stats.cells, 24);
+        assert.strictEqual(t.root.stats.glyphs, 1);
+        // Row 2 splits around the blue cell
+        assert.strictEqual(t.root.stats.runs, 5);
+    },
+
+    'present_cells redraws only cells that changed since the last buffer': function() {
+        var t = setup(4, 2);
+        var palette = ['black', 'white', 'green'];
+        var cells = new Uint32Array(4 * 2 * 2);
+        for (var i = 0; i < 8; i++) {
+            cells[2 * i] = 46;               // '.'
+            cells[2 * i + 1] = 1 | (0 << 16); // white on black
+        }
+        t.root.present_cells(cells, 4, 2, palette);
+        assert.strictEqual(t.root.cells_presented, 8);
+
+        cells[2 * 5] = 64;                   // '@' at (1, 1)
+        cells[2 * 5 + 1] = 2 | (0 << 16);    // green
+        t.canvas.calls.length = 0;
+        t.root.present_cells(cells, 4, 2, palette);
+        assert.strictEqual(t.root.cells_presented, 1);
+        assert.strictEqual(t.root.stats.cells, 1);
+        var texts = ops(t.canvas, 'fillText');
+        assert.deepStrictEqual(texts.map(function(c) { return [c.text, c.style]; }), [['@', 'green']]);
+
+        t.canvas.calls.length = 0;
+        t.root.present_cells(cells, 4, 2, palette);
+        assert.strictEqual(t.root.cells_presented, 0);
+        assert.strictEqual(t.canvas.calls.length, 0);
+    },
+
+    'a new buffer size presents every cell': function() {
+        var t = setup(4, 2);
+        var palette = ['black', 'white'];
+        t.root.present_cells(new Uint32Array(4 * 2 * 2), 4, 2, palette);
+        t.root.present_cells(new Uint32Array(3 * 2 * 2), 3, 2, palette);
+        assert.strictEqual(t.root.cells_presented, 6);
+    },
+};
+
+var failed = 0;
+for (var name in tests) {
+    try {
+        tests[name]();
+        console.log('ok   ' + name);
+    } catch (e) {
+        failed++;
+        console.log('FAIL ' + name + '\n     ' + e.message);
+    }
+}
+process.exit(failed ? 1 : 0);
@@ -0,0 +1,63 @@
+#ifndef actionqueue_hpp
+#define actionqueue_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// calendar queue of values ordered by the tick they are due on
+// buckets are indexed by tick modulo the bucket count, so push and pop are
+// O(1) as long as most delays are shorter than the calendar length;
+// values due on the same tick pop in the order they were pushed
+template <typename T>
+class ActionQueue {
+public:
+  explicit ActionQueue(int bucketBits = 6):buckets_(size_t(1) << bucketBits), mask_((uint32_t(1) << bucketBits) - 1){}
+
+  // ticks that have already passed are due on the next tick
+  void push(uint32_t tick, T value){
+    if (tick <= now_) tick = now_ + 1;
+    buckets_[tick & mask_].push_back(Entry {tick, std::move(value)});
+    size_++;
+  }
+
+  // pops every value due up to and including now, calling f(value) in tick order
+  // f may push new values, which must be due on a later tick
+  template <typename F>
+  void popUntil(uint32_t now, F&& f){
+    while (now_ < now){
+      now_++;
+      auto& bucket = buckets_[now_ & mask_];
+      if (bucket.empty()) continue;
+
+      due_.clear();
+      auto keep = bucket.begin();
+      for (auto it = bucket.begin(); it != bucket.end(); ++it){
+        if (it->tick == now_) due_.push_back(std::move(it->value));
+        else *keep++ = std::move(*it);
+      }
+      bucket.erase(keep, bucket.end());
+
+      size_ -= due_.size();
+      for (auto& value: due_) f(value);
+    }
+  }
+
+  uint32_t now() const { return now_; }
+  size_t size() const { return size_; }
+
+protected:
+  struct Entry {
+    uint32_t tick;
+    T value;
+  };
+
+  std::vector<std::vector<Entry>> buckets_;
+  std::vector<T> due_ {};
+  uint32_t mask_;
+  uint32_t now_ = 0;
+  size_t size_ = 0;
+};
+
+#endif /* actionqueue_hpp */
@@ -0,0 +1,76 @@
+#ifndef damage_hpp
+#define damage_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// tracks which screen cells need recomposing this frame
+// keeps the dirty extent of each row; every cell inside an extent is recomposed,
+// so layers can copy whole spans and clean rows are skipped
+class DamageTracker {
+public:
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // resizing damages everything
+  void resize(int width, int height){
+    width_ = width;
+    height_ = height;
+    rowMin_.assign(height, INT32_MAX);
+    rowMax_.assign(height, INT32_MIN);
+    markAll();
+  }
+
+  void markAll(){
+    full_ = true;
+  }
+
+  void mark(int x, int y){
+    if (full_ || x < 0 || y < 0 || x >= width_ || y >= height_) return;
+    rowMin_[y] = std::min(rowMin_[y], x);
+    rowMax_[y] = std::max(rowMax_[y], x + 1);
+  }
+
+  void markRect(int x, int y, int w, int h){
+    if (full_) return;
+    int x0 = std::max(x, 0), x1 = std::min(x + w, width());
+    int y0 = std::max(y, 0), y1 = std::min(y + h, height());
+    if (x0 >= x1) return;
+    for (int j = y0; j < y1; j++){
+      rowMin_[j] = std::min(rowMin_[j], x0);
+      rowMax_[j] = std::max(rowMax_[j], x1);
+    }
+  }
+
+  bool full() const { return full_; }
+
+  bool dirty(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) return false;
+    return full_ || (x >= rowMin_[y] && x < rowMax_[y]);
+  }
+
+  // calls f(y, x0, x1) with the dirty extent [x0, x1) of each damaged row
+  template <typename F>
+  void forEachRow(F&& f) const {
+    for (int y = 0; y < height(); y++){
+      if (full_) f(y, 0, width());
+      else if (rowMin_[y] < rowMax_[y]) f(y, rowMin_[y], rowMax_[y]);
+    }
+  }
+
+  void clear(){
+    std::fill(rowMin_.begin(), rowMin_.end(), INT32_MAX);
+    std::fill(rowMax_.begin(), rowMax_.end(), INT32_MIN);
+    full_ = false;
+  }
+
+protected:
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<int> rowMin_ {};
+  std::vector<int> rowMax_ {};
+  bool full_ = true;
+};
+
+#endif /* damage_hpp */
@@ -42,8 +42,8 @@ public:
   }
   
   // common
-  int age = 0;
-  int life = -1; // if >= 0 determines a finite life
+  int spawnTick = 0; // world tick the entity was created on
+  int life = -1;     // if >= 0 determines a finite life
   
   // components
   ident sprite  {invalid_id};
@@ -13,8 +13,8 @@ struct EvRemove   { ident entity; };
 struct EvKillMob  { ident who; };
 struct EvSpawnMob { MobType type; vec2i position; };
 // Mob Actions
-struct EvTryWalk  { ident mob; vec2i from; vec2i to; };
-struct EvWalked   { ident mob; vec2i from; vec2i to; };
+struct EvTryWalk  { ident mob; vec2i from; vec2i to; int64_t inputStamp = 0; }; // stamp of the key that caused it, if any
+struct EvWalked   { ident mob; vec2i from; vec2i to; int64_t inputStamp = 0; };
 struct EvAttack   { ident mob; ident target; };
 
 using  EvAny = variant<
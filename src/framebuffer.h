@@ -0,0 +1,108 @@
+#ifndef framebuffer_hpp
+#define framebuffer_hpp
+
+#include "termbox.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// a single screen cell, laid out like termbox's tb_cell
+struct Cell {
+  uint32_t ch;
+  uint16_t fg;
+  uint16_t bg;
+};
+
+inline bool operator==(const Cell& a, const Cell& b){ return a.ch == b.ch && a.fg == b.fg && a.bg == b.bg; }
+inline bool operator!=(const Cell& a, const Cell& b){ return !(a == b); }
+
+// composites layered draws into one cell per screen position
+// every write carries a depth and only lands at or above the depth already
+// there, so layers can be drawn in any order and the top-most glyph wins
+class FrameBuffer {
+public:
+  FrameBuffer():cells_(0, 0, Cell {' ', TB_WHITE, TB_BLACK}), depth_(0, 0, 0){}
+
+  int width() const { return cells_.width(); }
+  int height() const { return cells_.height(); }
+
+  void resize(int width, int height){
+    cells_.resize(width, height);
+    depth_.resize(width, height);
+  }
+
+  // clears [x0, x1) of row y back to the lowest depth
+  void reset(int y, int x0, int x1){
+    std::fill(&depth_(x0, y), &depth_(x0, y) + (x1 - x0), 0);
+  }
+
+  // moves rows [top, bottom) by (dx, dy), as the window does on a camera pan
+  void scroll(int top, int bottom, int dx, int dy){
+    cells_.shift(top, bottom, dx, dy);
+    depth_.shift(top, bottom, dx, dy);
+  }
+
+  void put(int x, int y, Cell cell, uint8_t depth){
+    if (!cells_.inBounds(x, y)) return;
+    uint8_t& d = depth_(x, y);
+    if (depth >= d){
+      cells_(x, y) = cell;
+      d = depth;
+    }
+  }
+
+  // puts count cells along row y starting at x, clipped to the buffer
+  void putRow(int x, int y, const Cell* cells, int count, uint8_t depth){
+    if (y < 0 || y >= height()) return;
+    int x0 = std::max(x, 0), x1 = std::min(x + count, width());
+    Cell* dst = &cells_(0, y);
+    uint8_t* d = &depth_(0, y);
+    for (int i = x0; i < x1; i++){
+      if (depth >= d[i]){
+        dst[i] = cells[i - x];
+        d[i] = depth;
+      }
+    }
+  }
+
+  // lays a run of single-byte glyphs in one colour at the lowest depth, for the
+  // first layer drawn after a reset; with no depth test, SSE2 widens 8 glyphs
+  // and pairs them with the colours in 4 stores
+  void putBase(int x, int y, const char* glyphs, int count, uint16_t fg, uint16_t bg){
+    if (y < 0 || y >= height()) return;
+    int x0 = std::max(x, 0), x1 = std::min(x + count, width());
+    Cell* dst = &cells_(0, y);
+    int i = x0;
+#ifdef __SSE2__
+    static_assert(sizeof(Cell) == 8, "Cell must be a glyph word then a colour word");
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i colours = _mm_set1_epi32((int) ((uint32_t) fg | (uint32_t) bg << 16));
+    for (; i + 8 <= x1; i += 8){
+      __m128i g8 = _mm_loadl_epi64((const __m128i*) (glyphs + i - x));
+      __m128i g16 = _mm_unpacklo_epi8(g8, zero);
+      __m128i lo = _mm_unpacklo_epi16(g16, zero), hi = _mm_unpackhi_epi16(g16, zero);
+      _mm_storeu_si128((__m128i*) (dst + i),     _mm_unpacklo_epi32(lo, colours));
+      _mm_storeu_si128((__m128i*) (dst + i + 2), _mm_unpackhi_epi32(lo, colours));
+      _mm_storeu_si128((__m128i*) (dst + i + 4), _mm_unpacklo_epi32(hi, colours));
+      _mm_storeu_si128((__m128i*) (dst + i + 6), _mm_unpackhi_epi32(hi, colours));
+    }
+#endif
+    for (; i < x1; i++){
+      dst[i] = Cell {(uint32_t) (unsigned char) glyphs[i - x], fg, bg};
+    }
+  }
+
+  const Cell& operator()(int x, int y) const { return cells_(x, y); }
+  const Cell* row(int y) const { return &cells_(0, y); }
+
+protected:
+  Array2D<Cell> cells_;
+  Array2D<uint8_t> depth_;
+};
+
+#endif /* framebuffer_hpp */
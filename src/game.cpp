@@ -1,12 +1,18 @@
 #include "game.h"
 
 #include "event.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <iostream>
 
 Game::Game(Window& window):window(window), mobSystem_(*this), physicsSystem_(*this), renderSystem_(*this), groundTiles_(worldBounds.width, worldBounds.height, '.'){
 }
 
-void Game::setup(){
+void Game::setup(int numMobs){
   const auto& b = worldBounds;
+  auto& r = rng(RngStream::World);
+  mobSystem_.setup();
   
   // Create player
   auto& playerMob = createMob(MobType::Player, {0,0});
@@ -15,22 +21,19 @@ void Game::setup(){
   cameraPosition = playerMob.position;
   
   // Setup terrain
+  groundTiles_.resize(b.width, b.height);
   groundTiles_.fill('.');
-  for (int x = b.left; x < b.left + b.width; x++){
-    for (int y = b.top - b.height + 1; y <= b.top; y++){
-      if (randInt(0, 6) == 0){
-        groundTile({x, y}) = choose({',','_',' '});
-      }
-    }
-  }
+  sampleGrid(r, groundTiles_.width(), groundTiles_.height(), 1.0 / 7, [&](int x, int y){
+    groundTiles_(x, y) = choose(r, {',','_',' '});
+  });
   
   // Populate world with mobs
-  int numMobs = (int) (0.5 * sqrt(b.width * b.height));
+  if (numMobs < 0) numMobs = (int) (0.5 * sqrt(b.width * b.height));
   for (int i=0; i<numMobs; i++){
-    MobType type = choose({MobType::Rabbit, MobType::OrcStrong, MobType::Snake});
+    MobType type = choose(r, {MobType::Rabbit, MobType::OrcStrong, MobType::Snake});
     vec2i pos {
-      randInt(b.left, b.left + b.width - 1),
-      randInt(b.top - b.height + 1, b.top)
+      randInt(r, b.left, b.left + b.width - 1),
+      randInt(r, b.top - b.height + 1, b.top)
     };
     createMob(type, pos);
     
@@ -40,13 +43,13 @@ void Game::setup(){
   // Mob-less sprites
   for (int i=0; i<numMobs / 2; i++){
     vec2i pos {
-      randInt(b.left, b.left + b.width - 1),
-      randInt(b.top - b.height + 1, b.top)
+      randInt(r, b.left, b.left + b.width - 1),
+      randInt(r, b.top - b.height + 1, b.top)
     };
-    if (randInt(0, 2) != 0){
+    if (randInt(r, 0, 2) != 0){
       createSprite("vV", true, 6, TB_MAGENTA, TB_BLACK, pos, RenderLayer::GroundCover);
     }
-    else if (randInt(0, 1) == 0){
+    else if (randInt(r, 0, 1) == 0){
       createSprite("|/-\\", true, 2, TB_YELLOW, TB_BLACK, pos, RenderLayer::GroundCover);
     }
     else {
@@ -60,10 +63,10 @@ void Game::setup(){
 }
 
 bool Game::update(){
-  handleInput();
+  PROFILE_ZONE("update");
   updateCamera(); // NB: Outside of world update
   
-  // Use this to slow down the world update
+  // World ticks once every subTicksPerTick fixed steps
   const int subTicksPerTick = 2;
   if (--subTick_ <= 0){
     subTick_ = subTicksPerTick;
@@ -72,166 +75,185 @@ bool Game::update(){
     bool updateWorld = (freezeTimer == 0);
 
     if (updateWorld){
+      worldTick_++;
       updatePlayer();
       
       for (auto* sys: systems_){
         sys->update();
       }
      
-      for (auto& e: entities.values()){
-        e.age++;
-        if (e.life > 0 && e.age >= e.life){
-          queueEvent(EvRemove {e.id} );
-        }
-      }
+      // Expire finite-life entities (stale timers for removed entities are ignored)
+      expiry_.advance(worldTick_, [this](ident id){
+        if (entities[id]) queueEvent(EvRemove {id});
+      });
       
       // Dirt system
-      for (auto& c: groundTiles_.data()){
-        // Roughen flat ground
-        if (c == '_' && randInt(0, 60) == 0) c = '.';
+      // Roughen flat ground, sampling every tile is the same as sampling each '_' at the same rate
+      {
+        PROFILE_ZONE("dirt");
+        auto& tiles = groundTiles_.data();
+        sampleRange(rng(RngStream::World), (int64_t) tiles.size(), 1.0 / 61, [&](int64_t i){
+          if (tiles[i] == '_'){
+            tiles[i] = '.';
+            int w = groundTiles_.width();
+            renderSystem_.markDirty({worldBounds.left + (int) (i % w), worldBounds.top - (int) (i / w)});
+          }
+        });
       }
     }
     
-    // Events
-    auto& events = events_[eventsIndex_];
-    eventsIndex_ = 1 - eventsIndex_; // toggle buffer
-    std::vector<ident> remove;
+    processEvents();
+    sync();
+    tick_++;
     
-    for (const EvAny& any: events){
-      const bool logEvents = false;
-      if (logEvents){
-        log(to_string(any));
-      }
-      
-      if (any.is<EvRemove>()){
-        const auto& ev = any.get<EvRemove>();
-        remove.push_back({ ev.entity });
+    while (!log_.empty()){
+      const auto& pair = log_.front();
+      if (tick_ > pair.second + 20){
+        log_.pop_front();
       }
-      else if (any.is<EvKillMob>()){
-        const auto& ev = any.get<EvKillMob>();
-        Mob& mob = mobs[ev.who];
-        auto& e = entities[mob.entity];
-        auto& sprite = sprites[e.sprite];
-        queueEvent(EvRemove { mob.entity });
+      else break;
+    }
+  }
+  
+  return true;
+}
 
-        if (onScreen(mob.position)){
-          cameraShake = true;
-          cameraShakeTimer = 0;
-          cameraShakeStrength = 2;
-          freezeTimer = 1;
-        }
-        
-        createBloodSplatter(mob.position);
-        createBones(sprite.frames[sprite.frame], mob.position);
-      }
-      else if (any.is<EvSpawnMob>()){
-        const auto& ev = any.get<EvSpawnMob>();
-        createMob(ev.type, ev.position);
-      }
-      else if (any.is<EvTryWalk>()){
-        // const auto& ev = any.get<EvTryWalk>();
-        // ...
+void Game::processEvents(){
+  PROFILE_ZONE("events");
+  
+  auto& events = events_[eventsIndex_];
+  eventsIndex_ = 1 - eventsIndex_; // toggle buffer
+  std::vector<ident> remove;
+  
+  for (const EvAny& any: events){
+    const bool logEvents = false;
+    if (logEvents){
+      log(to_string(any));
+    }
+    
+    if (any.is<EvRemove>()){
+      const auto& ev = any.get<EvRemove>();
+      remove.push_back({ ev.entity });
+    }
+    else if (any.is<EvKillMob>()){
+      TRACE_INSTANT("kill mob");
+      const auto& ev = any.get<EvKillMob>();
+      Mob& mob = mobs[ev.who];
+      auto& e = entities[mob.entity];
+      auto& sprite = sprites[e.sprite];
+      queueEvent(EvRemove { mob.entity });
+
+      if (onScreen(mob.position)){
+        cameraShake = true;
+        cameraShakeTimer = 0;
+        cameraShakeStrength = 2;
+        freezeTimer = 1;
       }
-      else if (any.is<EvWalked>()){
-        const auto& ev = any.get<EvWalked>();
-        if (ev.mob == entities[player].mob){
-          // Camera tracks player
-          const vec2i margin { 8, 4 };
-          vec2i newScreenPos = screenCoord(ev.to);
-          if ((window.width() - newScreenPos.x) < margin.x){
-            cameraTarget.x += margin.x;
-          }
-          else if (newScreenPos.x < margin.x){
-            cameraTarget.x -= margin.x;
-          }
-          else if ((window.height() - newScreenPos.y) < margin.y){
-            cameraTarget.y -= margin.y;
-          }
-          else if (newScreenPos.y < margin.y){
-            cameraTarget.y += margin.y;
-          }
+      
+      createBloodSplatter(mob.position);
+      createBones(sprite.glyph(animClock(worldTick_)), mob.position);
+    }
+    else if (any.is<EvSpawnMob>()){
+      TRACE_INSTANT("spawn mob");
+      const auto& ev = any.get<EvSpawnMob>();
+      createMob(ev.type, ev.position);
+    }
+    else if (any.is<EvTryWalk>()){
+      // const auto& ev = any.get<EvTryWalk>();
+      // ...
+    }
+    else if (any.is<EvWalked>()){
+      const auto& ev = any.get<EvWalked>();
+      if (ev.mob == entities[player].mob){
+        // Camera tracks player
+        const vec2i margin { 8, 4 };
+        vec2i newScreenPos = screenCoord(ev.to);
+        if ((window.width() - newScreenPos.x) < margin.x){
+          cameraTarget.x += margin.x;
         }
-      }
-      else if (any.is<EvAttack>()){
-        const auto& ev = any.get<EvAttack>();
-        if (onScreen(mobs[ev.target].position)){
-          cameraShake = true;
-          cameraShakeTimer = 0;
-          cameraShakeStrength = 1;
+        else if (newScreenPos.x < margin.x){
+          cameraTarget.x -= margin.x;
+        }
+        else if ((window.height() - newScreenPos.y) < margin.y){
+          cameraTarget.y -= margin.y;
+        }
+        else if (newScreenPos.y < margin.y){
+          cameraTarget.y += margin.y;
         }
       }
-      
-      for (auto* sys: systems_){
-        sys->handleEvent(any);
+    }
+    else if (any.is<EvAttack>()){
+      const auto& ev = any.get<EvAttack>();
+      if (onScreen(mobs[ev.target].position)){
+        cameraShake = true;
+        cameraShakeTimer = 0;
+        cameraShakeStrength = 1;
       }
     }
-    events.clear();
     
-    auto it = remove.begin();
-    while (it != remove.end()){
-      const ident& id = *it;
-      Entity& e = entities[id];
-      if (!e){
-        ++it;
-        continue; // Already removed
-      }
-      
-      using cid = std::pair<ComponentType, ident>;
-      auto comps = {
-        cid {ComponentType::Mob,     e.mob},
-        cid {ComponentType::Sprite,  e.sprite},
-        cid {ComponentType::Physics, e.physics}
-      };
-      
-      for (auto pair: comps){
-        ident component = pair.second;
-        if (component){
-          ComponentType type = pair.first;
-          
-          switch (type){
-            default: break;
-            case ComponentType::Mob: {
-              mobs.remove(component);
-              break;
-            }
-            case ComponentType::Sprite: {
-              sprites.remove(component);
-              break;
-            }
-            case ComponentType::Physics: {
-              physics.remove(component);
-              break;
-            }
+    for (auto* sys: systems_){
+      sys->handleEvent(any);
+    }
+  }
+  events.clear();
+  
+  auto it = remove.begin();
+  while (it != remove.end()){
+    const ident& id = *it;
+    Entity& e = entities[id];
+    if (!e){
+      ++it;
+      continue; // Already removed
+    }
+    
+    using cid = std::pair<ComponentType, ident>;
+    auto comps = {
+      cid {ComponentType::Mob,     e.mob},
+      cid {ComponentType::Sprite,  e.sprite},
+      cid {ComponentType::Physics, e.physics}
+    };
+    
+    for (auto pair: comps){
+      ident component = pair.second;
+      if (component){
+        ComponentType type = pair.first;
+        
+        switch (type){
+          default: break;
+          case ComponentType::Mob: {
+            mobSystem_.remove(mobs[component]);
+            mobs.remove(component);
+            break;
+          }
+          case ComponentType::Sprite: {
+            sprites.remove(component);
+            break;
+          }
+          case ComponentType::Physics: {
+            physics.remove(component);
+            break;
           }
         }
       }
-      
-      for (const auto& ch: e.children){
-        queueEvent( EvRemove {ch} );
-      }
-      e.children.clear();
-      
-      entities.remove(id);
-      it++;
     }
     
-    sync();
-    tick_++;
-    
-    while (!log_.empty()){
-      const auto& pair = log_.front();
-      if (tick_ > pair.second + 20){
-        log_.pop_front();
-      }
-      else break;
+    for (const auto& ch: e.children){
+      queueEvent( EvRemove {ch} );
     }
+    e.children.clear();
+    
+    entities.remove(id);
+    it++;
   }
-  
-  return true;
 }
 
 void Game::render(){
-  window.clear();
+  PROFILE_ZONE("render");
+  
+  // The log covers the world, so uncover last frame's rows, and keep the
+  // header, log and footer out of camera pans
+  renderSystem_.damage().markRect(0, 0, window.width(), logRows_);
+  renderSystem_.setScrollRegion(std::max(logRows_, 1), window.height() - 1);
   renderSystem_.render();
   
   const bool showLog = true;
@@ -245,41 +267,35 @@ void Game::render(){
     int y = 0;
     for (const auto& message: log_){
       auto tick = std::to_string(message.second);
-      for (int x = 0; x < (int) tick.size(); x++){
-        window.set(x, y, tick[x], TB_WHITE, TB_BLUE);
-      }
-      for (int x = (int) tick.size(); x < 6; x++){
-        window.set(x, y, ' ', TB_WHITE, TB_BLUE);
-      }
-      for (int x = 0; x < (int) message.first.size(); x++){
-        window.set(6 + x, y, message.first[x], TB_WHITE, TB_BLUE);
-      }
+      if (tick.size() < 6) tick.resize(6, ' ');
+      window.setRow(y, 0, tick, TB_WHITE, TB_BLUE);
+      window.setRow(y, 6, message.first, TB_WHITE, TB_BLUE);
       y++;
       if (y > maxMessages) break;
     }
+    
+    // Below the messages, clear of the header
+    if (Profiler::enabled()){
+      y = std::max(y, 1);
+      for (const auto& line: Profiler::overlay()){
+        window.setRow(y++, 0, line, TB_WHITE, TB_MAGENTA);
+      }
+    }
+    logRows_ = y;
 #endif
   }
 
   std::string header = "Some Roguelike Thing";
-  for (int x = 0; x < (int) header.size(); x++){
-    window.set(x, 0, header[x], TB_WHITE, TB_BLUE);
-  }
-  for (int x = (int) header.size(); x < window.width(); x++){
-    window.set(x, 0, ' ', TB_WHITE, TB_BLUE);
-  }
+  header.resize(std::max((int) header.size(), window.width()), ' ');
+  window.setRow(0, 0, header, TB_WHITE, TB_BLUE);
   
 #ifdef __EMSCRIPTEN__
-  std::string footer = "Arrows: Move. Code: https://github.com/eigenbom/game-example.";
+  std::string footer = "Arrows: Move. L: Latency. P: Profiler. Code: https://github.com/eigenbom/game-example.";
 #else
-  std::string footer = "ESC: Exit. Arrows: Move.";
+  std::string footer = "ESC: Exit. Arrows: Move. L: Latency. P: Profiler. T: Trace.";
 #endif
 
-  for (int x = 0; x < (int) footer.size(); x++){
-    window.set(x, window.height()-1, footer[x], TB_WHITE, TB_BLUE);
-  }
-  for (int x = (int) footer.size(); x < window.width(); x++){
-    window.set(x, 0, ' ', TB_WHITE, TB_BLUE);
-  }
+  window.setRow(window.height() - 1, 0, footer, TB_WHITE, TB_BLUE);
 }
 
 vec2i Game::worldCoord(vec2i screenCoord) const {
@@ -303,10 +319,28 @@ bool Game::onScreen(vec2i worldCoord) const {
 }
 
 void Game::queueEvent(const EvAny &ev){
+  // A walk is queued as it happens, so it's on screen from the next present
+  if (ev.is<EvWalked>() && ev.get<EvWalked>().inputStamp){
+    unshownInput_.push_back(ev.get<EvWalked>().inputStamp);
+  }
   events_[eventsIndex_].push_back(ev);
 }
 
+void Game::presented(){
+  if (unshownInput_.empty()) return;
+  int64_t now = stampNow();
+  for (int64_t stamp: unshownInput_){
+    inputLatency_.record(now - stamp);
+  }
+  unshownInput_.clear();
+}
+
+void Game::unpresented(){
+  unshownInput_.clear();
+}
+
 void Game::sync(){
+  PROFILE_ZONE("sync");
   entities.sync();
   mobs.sync();
   sprites.sync();
@@ -317,10 +351,18 @@ void Game::log(const std::string message){
   log_.push_back({message, tick_});
 }
 
+void Game::setLife(Entity& e, int life){
+  e.life = life;
+  if (life >= 0){
+    expiry_.schedule(e.spawnTick + life, e.id);
+  }
+}
+
 Sprite& Game::createSprite(std::string frames, bool animated, int frameRate, uint16_t fg, uint16_t bg, vec2i position, RenderLayer renderLayer){
   auto& e = entities.add();
+  e.spawnTick = worldTick_;
   
-  auto& spr = sprites.add(Sprite {frames, animated, frameRate, fg, bg, position, renderLayer});
+  auto& spr = sprites.add(Sprite {frames, animated, frameRate, fg, bg, position, renderLayer, animClock(worldTick_)});
   spr.entity = e.id;
   e.sprite = spr.id;
   return spr;
@@ -328,6 +370,7 @@ Sprite& Game::createSprite(std::string frames, bool animated, int frameRate, uin
 
 Mob& Game::createMob(MobType type, vec2i position){
   auto& e = entities.add();
+  e.spawnTick = worldTick_;
   
   auto& info = MobDatabase.at(type);
   Mob& mob = mobs.add(Mob {&info});
@@ -336,6 +379,7 @@ Mob& Game::createMob(MobType type, vec2i position){
   
   mob.health = info.health;
   mob.position = position;
+  mobSystem_.add(mob);
   
   const char* frames = "?!";
   int frameRate = 1;
@@ -348,7 +392,7 @@ Mob& Game::createMob(MobType type, vec2i position){
     case MobCategory::Player: frames = "@"; break;
     default: frames = "?!"; break;
   }
-  auto& spr = sprites.add(Sprite(frames, frameRate > 0, frameRate, fg, bg, position, RenderLayer::Mob));
+  auto& spr = sprites.add(Sprite(frames, frameRate > 0, frameRate, fg, bg, position, RenderLayer::Mob, animClock(worldTick_)));
   e.sprite = spr.id;
   spr.entity = e.id;
   
@@ -381,33 +425,40 @@ Mob& Game::createMob(MobType type, vec2i position){
 
 void Game::createBloodSplatter(vec2i position){
   if (sprites.size() >= sprites.max_size() / 2) return;
+  auto& r = rng(RngStream::Effects);
   
-  const int radius = 3;
-  const int sqradius = radius * radius;
-  for (int dx = -radius; dx <= radius; dx++){
-    for (int dy = -radius; dy <= radius; dy ++){
-      if ((dx * dx + dy * dy) <= sqradius){
-        if (randInt(0, 4) != 0){
-          auto& spr = createSprite(".", false, 0, TB_RED, TB_BLACK, position + vec2i {dx, dy}, RenderLayer::Ground);
-          auto& e = entities[spr.entity];
-          e.life = randInt(200, 300);
+  static const std::vector<vec2i> disc = [](){
+    const int radius = 3;
+    const int sqradius = radius * radius;
+    std::vector<vec2i> cells;
+    for (int dx = -radius; dx <= radius; dx++){
+      for (int dy = -radius; dy <= radius; dy ++){
+        if ((dx * dx + dy * dy) <= sqradius){
+          cells.push_back({dx, dy});
         }
       }
     }
-  }
+    return cells;
+  }();
+  
+  sampleRange(r, (int64_t) disc.size(), 4.0 / 5, [&](int64_t i){
+    auto& spr = createSprite(".", false, 0, TB_RED, TB_BLACK, position + disc[i], RenderLayer::Ground);
+    auto& e = entities[spr.entity];
+    setLife(e, randInt(r, 200, 300));
+  });
   
-  int numBloodParticles = randInt(10, 40);
+  int numBloodParticles = randInt(r, 10, 40);
   for (int i = 0; i < numBloodParticles; i++){
     auto& spr = createSprite("o", false, 0, TB_RED, TB_BLACK, position, RenderLayer::Particles);
     auto& e = entities[spr.entity];
-    e.life = randInt(6, 12);
+    setLife(e, randInt(r, 6, 12));
     
-    double vel = random(0.4, 0.6);
+    double vel = random(r, 0.4, 0.6);
     
     Physics& ph = physics.add();
     ph.type = PhysicsType::Projectile;
     ph.position = (vec2d) position;
-    double th = random(-M_PI, M_PI);
+    double th = random(r, -M_PI, M_PI);
     ph.velocity.x = vel * cos(th);
     ph.velocity.y = vel * sin(th);
     
@@ -419,13 +470,32 @@ void Game::createBloodSplatter(vec2i position){
 void Game::createBones(char c, vec2i position){
   auto& spr = createSprite(std::string(1, c), false, 0, TB_RED, TB_BLACK, position, RenderLayer::Ground);
   auto& e = entities[spr.entity];
-  e.life = randInt(100, 110);
+  setLife(e, randInt(rng(RngStream::Effects), 100, 110));
 }
 
 void Game::handleInput(){
   for (auto ev: window.events()){
+    if (ev.type == WindowEvent::Resize){
+      TRACE_INSTANT("resize");
+      renderSystem_.damage().markAll();
+      continue;
+    }
+    if (ev.type == WindowEvent::ShowLatency){
+      log("Input latency: " + inputLatency_.summary());
+      continue;
+    }
+    if (ev.type == WindowEvent::ToggleProfiler){
+      Profiler::setEnabled(!Profiler::enabled());
+      continue;
+    }
+    if (ev.type == WindowEvent::WriteTrace){
+      if (!Trace::enabled()) log("Not tracing, run with --trace FILE");
+      else if (Trace::flush()) log("Trace written to " + Trace::lastPath());
+      continue;
+    }
+    
     bool isPlayerMove = [ev](){
-      switch (ev){
+      switch (ev.type){
         case WindowEvent::ArrowUp:
         case WindowEvent::ArrowDown:
         case WindowEvent::ArrowLeft:
@@ -444,18 +514,23 @@ void Game::handleInput(){
 }
 
 void Game::updatePlayer(){
+  if (windowEvents_.empty()) return;
+  
   auto& entity = entities[player];
   auto& mob    = mobs[entity.mob];
   
-  mob.tick += mob.info->speed;
-  mob.tick = std::min(mob.tick, 2 * Mob::TicksPerAction - 1);
+  // Energy accrues lazily, it's only brought up to date when there's input to act on
+  mob.energy = std::min(mob.energy + (worldTick_ - mob.energyTick) * mob.info->speed, 2 * Mob::TicksPerAction - 1);
+  mob.energyTick = worldTick_;
   
   // Map input to player commands
   vec2i movePlayer {0, 0};
+  int64_t inputStamp = 0;
   
   while (!windowEvents_.empty()){
     const auto& ev = windowEvents_.front();
-    switch (ev){
+    inputStamp = ev.stamp;
+    switch (ev.type){
       default:
         break;
       case WindowEvent::ArrowUp:
@@ -474,9 +549,9 @@ void Game::updatePlayer(){
     
     // A move requires a full action
     if (movePlayer != vec2i {0, 0}){
-      if (mob.tick >= Mob::TicksPerAction){
+      if (mob.energy >= Mob::TicksPerAction){
         windowEvents_.pop_front();
-        mob.tick -= Mob::TicksPerAction;
+        mob.energy -= Mob::TicksPerAction;
         break;
       }
       else {
@@ -502,13 +577,14 @@ void Game::updatePlayer(){
       queueEvent(EvAttack {mob.id, target} );
     }
     else {
-      queueEvent(EvTryWalk {mob.id, oldPos, newPos});
+      queueEvent(EvTryWalk {mob.id, oldPos, newPos, inputStamp});
     }
   }
 }
 
 void Game::updateCamera() {
   if (cameraShake){
+    auto& r = rng(RngStream::Effects);
     cameraShakeTimer++;
     if (cameraShakeStrength == 1) cameraShakeTimer ++;
     
@@ -519,15 +595,15 @@ void Game::updateCamera() {
     }
     else if (cameraShakeTimer % 2 == 0){
       if (cameraShakeStrength == 1){
-        if (randInt(0, 1) == 0){
-          cameraShakeOffset = vec2i {randInt(-1, 1), 0};
+        if (randInt(r, 0, 1) == 0){
+          cameraShakeOffset = vec2i {randInt(r, -1, 1), 0};
         }
         else {
-          cameraShakeOffset = vec2i {0, randInt(-1, 1)};
+          cameraShakeOffset = vec2i {0, randInt(r, -1, 1)};
         }
       }
       else {
-        cameraShakeOffset = vec2i {randInt(-1, 1), randInt(-1, 1)};
+        cameraShakeOffset = vec2i {randInt(r, -1, 1), randInt(r, -1, 1)};
       }
     }
   }
@@ -3,12 +3,14 @@
 
 #include "entity.h"
 #include "event.h"
+#include "latency.h"
 #include "mob.h"
 #include "mobsystem.h"
 #include "physics.h"
 #include "physicssystem.h"
 #include "rendersystem.h"
 #include "system.h"
+#include "timerwheel.h"
 #include "util.h"
 #include "window.h"
 
@@ -20,19 +22,38 @@
 class Game {
 public:
   Game(Window& window);
-  void setup();
+  void setup(int numMobs = -1); // fills worldBounds, -1 scales the mob count with its area
   void queueEvent(const EvAny& ev);  
-  bool update();
+  void handleInput(); // once per frame, before any steps
+  bool update();      // one fixed step
   void render();
+  void presented();   // once the window has shown what render() drew
+  void unpresented(); // instead, when nothing will be shown (headless without rendering)
   
   vec2i worldCoord(vec2i screenCoord) const; // Map screen point to world point
   vec2i screenCoord(vec2i worldCoord) const; // Map world point to screen point
   bool onScreen(vec2i worldCoord) const;
   
+  int worldTick() const { return worldTick_; }
+  const LatencyHistogram& inputLatency() const { return inputLatency_; } // key press to the move on screen
+  int age(const Entity& e) const { return worldTick_ - e.spawnTick; }
+  void setLife(Entity& e, int life); // expires the entity life world ticks after it spawned
+  
   char& groundTile(vec2i p){
     vec2i q {p.x - worldBounds.left, worldBounds.top - p.y};
     return groundTiles_(q);
   }
+  
+  void setGroundTile(vec2i p, char c){
+    groundTile(p) = c;
+    renderSystem_.markDirty(p);
+  }
+  
+  // rows run from worldBounds.top downwards
+  const Array2D<char>& groundTiles() const { return groundTiles_; }
+  
+  const MobSystem& mobSystem() const { return mobSystem_; }
+  RenderSystem& renderSystem() { return renderSystem_; }
 
 public:
   Window& window;
@@ -55,15 +76,22 @@ public:
 protected:
   int tick_ = 0;
   int subTick_ = 0;
+  int worldTick_ = 0;
+  
+  TimerWheel<ident> expiry_;
   
   std::array<std::vector<EvAny>, 2> events_ {};
   int eventsIndex_ = 0;
 
   std::deque<std::pair<std::string, int>> log_;
+  int logRows_ = 0; // screen rows covered by the log last frame
   
   Array2D<char> groundTiles_;
   
-  std::deque<WindowEvent> windowEvents_;
+  std::deque<InputEvent> windowEvents_;
+  
+  LatencyHistogram inputLatency_;
+  std::vector<int64_t> unshownInput_ {}; // stamps of moves made since the last present
   
   MobSystem mobSystem_;
   PhysicsSystem physicsSystem_;
@@ -75,7 +103,7 @@ protected:
   };
 
   void sync();
-  void handleInput();
+  void processEvents(); // the events queued last tick, then removals
   void updatePlayer();
   void updateCamera();
   
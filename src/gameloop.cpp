@@ -0,0 +1,89 @@
+#include "gameloop.h"
+
+#include "game.h"
+#include "profiler.h"
+#include "trace.h"
+#include "window.h"
+
+GameLoop::GameLoop(Window& window, Game& game, Config config):window_(window), game_(game), config_(config){
+}
+
+void GameLoop::run(){
+  while (frame()){}
+}
+
+bool GameLoop::frame(){
+  if (config_.maxSteps >= 0 && steps_ >= config_.maxSteps) return false;
+  Trace::update(); // between frames, so no span is cut short
+
+  if (!window_.handleEvents()) return false;
+  game_.handleInput();
+
+  if (config_.headless){
+    if (!step()) return false;
+    if (config_.renderEvery <= 0){
+      game_.unpresented(); // moves are never shown, so there's no latency to wait for
+    }
+    else if (steps_ % config_.renderEvery == 0){
+      present();
+    }
+    Profiler::endFrame();
+    return true;
+  }
+
+  auto now = clock::now();
+  if (!started_){
+    started_ = true;
+    last_ = now;
+    accumulator_ = config_.step; // run the first step immediately
+  }
+  else {
+    accumulator_ += std::chrono::duration_cast<duration>(now - last_);
+    last_ = now;
+  }
+
+  int stepsThisFrame = 0;
+  while (accumulator_ >= config_.step && stepsThisFrame < config_.maxStepsPerFrame){
+    if (!step()) return false;
+    accumulator_ -= config_.step;
+    stepsThisFrame++;
+  }
+
+  // Too far behind (e.g. stalled terminal), so drop the backlog rather than spiral
+  if (accumulator_ >= config_.step){
+    TRACE_INSTANT("dropped steps");
+    droppedSteps_ += accumulator_ / config_.step;
+    accumulator_ %= config_.step;
+  }
+
+  if (stepsThisFrame > 0){
+    present();
+    Profiler::endFrame();
+  }
+
+#ifndef __EMSCRIPTEN__ // The browser calls frame() on its own interval
+  // Sleep until the next step is due, but wake for input so it's taken as soon as it lands
+  auto remaining = config_.step - accumulator_ - std::chrono::duration_cast<duration>(clock::now() - last_);
+  if (remaining > duration {0}){
+    window_.waitEvents(remaining);
+  }
+#endif
+
+  return true;
+}
+
+bool GameLoop::step(){
+  steps_++;
+  return game_.update();
+}
+
+void GameLoop::present(){
+  game_.render();
+  bool shown;
+  {
+    PROFILE_ZONE("present");
+    shown = window_.render();
+  }
+  // A dropped frame shows nothing, so pending moves wait for the next one
+  if (shown) game_.presented();
+}
@@ -0,0 +1,53 @@
+#ifndef gameloop_hpp
+#define gameloop_hpp
+
+#include <chrono>
+#include <cstdint>
+
+class Game;
+class Window;
+
+// Drives the game with a fixed simulation timestep.
+// Each frame takes all pending input, runs as many fixed steps as the elapsed
+// time requires (up to a catch-up limit), renders once and then waits for
+// input or the next step, whichever comes first. In headless mode steps run
+// back-to-back.
+class GameLoop {
+public:
+  using clock = std::chrono::steady_clock;
+  using duration = std::chrono::microseconds;
+
+  struct Config {
+    duration step {15000};     // length of one simulation step
+    int maxStepsPerFrame = 4;  // catch-up limit, excess time is dropped
+    bool headless = false;     // run steps as fast as possible
+    int renderEvery = 0;       // headless only: render every n steps (0 = never)
+    int64_t maxSteps = -1;     // stop after this many steps (-1 = run until quit)
+  };
+
+  GameLoop(Window& window, Game& game, Config config);
+
+  void run();   // loops until quit
+  bool frame(); // runs a single frame, returns false on quit
+
+  int64_t steps() const { return steps_; }
+  int64_t droppedSteps() const { return droppedSteps_; }
+
+protected:
+  bool step();
+  void present();
+
+protected:
+  Window& window_;
+  Game& game_;
+  Config config_;
+
+  clock::time_point last_ {};
+  duration accumulator_ {0};
+  bool started_ = false;
+
+  int64_t steps_ = 0;
+  int64_t droppedSteps_ = 0;
+};
+
+#endif /* gameloop_hpp */
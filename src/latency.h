@@ -0,0 +1,86 @@
+#ifndef latency_hpp
+#define latency_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// microseconds on the steady clock, carried by input through to the frame that shows it
+inline int64_t stampNow(){
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// histogram of latencies in microseconds
+// buckets are exact below 64us, then 32 per power of two (about 3% wide),
+// so percentiles come out at a fixed relative precision in constant memory
+class LatencyHistogram {
+public:
+  LatencyHistogram():buckets_(Exact + Octaves * Sub, 0){}
+
+  void record(int64_t us){
+    if (us < 0) us = 0;
+    buckets_[bucket(us)]++;
+    count_++;
+    sum_ += us;
+    if (us > max_) max_ = us;
+  }
+
+  int64_t count() const { return count_; }
+  int64_t max() const { return max_; }
+  int64_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+  // upper edge of the bucket holding the p-th percentile, clamped to the max seen
+  int64_t percentile(double p) const {
+    if (count_ == 0) return 0;
+    int64_t rank = std::max<int64_t>(1, (int64_t) std::ceil(p / 100 * count_)), seen = 0;
+    for (size_t i = 0; i < buckets_.size(); i++){
+      seen += buckets_[i];
+      if (seen >= rank) return std::min(upper(i), max_);
+    }
+    return max_;
+  }
+
+  std::string summary() const {
+    char text[128];
+    snprintf(text, sizeof(text), "%lld samples, p50 %.1fms, p99 %.1fms, max %.1fms", (long long) count_,
+             percentile(50) / 1000.0, percentile(99) / 1000.0, max_ / 1000.0);
+    return text;
+  }
+
+protected:
+  static const int Exact = 64;
+  static const int Sub = 32;
+  static const int Octaves = 36; // up to about 12 days
+
+  static int msb(uint64_t v){
+    int n = 0;
+    while (v >>= 1) n++;
+    return n;
+  }
+
+  static size_t bucket(int64_t us){
+    if (us < Exact) return (size_t) us;
+    int top = std::min(msb((uint64_t) us), 6 + Octaves - 1);
+    int shift = top - 5;
+    return Exact + (top - 6) * Sub + (size_t) (((uint64_t) us >> shift) & (Sub - 1));
+  }
+
+  static int64_t upper(size_t i){
+    if (i < (size_t) Exact) return (int64_t) i;
+    int k = (int) (i - Exact), shift = k / Sub + 1;
+    return ((int64_t) (Sub + k % Sub + 1) << shift) - 1;
+  }
+
+protected:
+  std::vector<uint32_t> buckets_;
+  int64_t count_ = 0;
+  int64_t sum_ = 0;
+  int64_t max_ = 0;
+};
+
+#endif /* latency_hpp */
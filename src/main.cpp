@@ -2,26 +2,150 @@
 // @eigenbom 2017
 
 #include "game.h"
+#include "gameloop.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "trace.h"
 #include "window.h"
 
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 #include <memory>
+#include <string>
 
 #ifndef __EMSCRIPTEN__ // Terminal Mode
 
-void runGame(){
+struct Options {
+  bool printStats = false;
+  bool asyncOutput = false;
+  int width = 0, height = 0; // off-screen only, 0 keeps the default
+  std::string dumpPath {};   // off-screen only
+  bool printHashes = false;  // off-screen only
+  bool fullRedraw = false;   // redraw every cell every frame, instead of only damaged ones
+  std::string recordPath {}; // asciicast, gzipped if it ends in .gz
+  bool profile = false;      // start with the profiler on
+  std::string tracePath {};  // Chrome trace, written on T, SIGUSR1 and exit
+};
+
+static void onTraceSignal(int){
+  Trace::requestFlush();
+}
+
+// Returns how long moves took to reach the screen, reported once the terminal is restored
+LatencyHistogram runGame(GameLoop::Config config, Options& options, Recorder& recorder){
   std::unique_ptr<Window> window { new Window };
-  std::unique_ptr<Game>   game { new Game {*window} };
+  if (recorder.isOpen()) window->setRecorder(&recorder);
   
+#ifdef NO_WINDOW
+  if (options.width > 0 && options.height > 0) window->setSize(options.width, options.height);
+  if (!options.dumpPath.empty()) window->setDumpFile(options.dumpPath);
+  if (options.printHashes) window->setHashLog(&std::cout);
+  options.asyncOutput = false; // nothing to write
+#else
+  if (options.asyncOutput && tb_set_async_output(1) != 0){
+    std::cerr << "async output unavailable, writing on the game thread\n";
+    options.asyncOutput = false;
+  }
+#endif
+  
+  std::unique_ptr<Game>   game { new Game {*window} };
+  game->renderSystem().setFullRedraw(options.fullRedraw);
   game->setup();
-  while (window->handleEvents()){
-    if (!game->update()) break;
-    game->render();
-    window->render();
+  GameLoop loop {*window, *game, config};
+  loop.run();
+  
+#ifdef NO_WINDOW
+  if (options.printStats){
+    std::cout << "off-screen output: " << window->frames() << " frames of " << window->width() << "x" << window->height()
+              << ", last hash " << std::hex << window->frameHash() << std::dec << "\n";
   }
+#endif
+  return game->inputLatency();
 }
 
 int main(int argc, const char * argv[]) {
-  runGame();
+  GameLoop::Config config;
+  Options options;
+#ifdef NO_WINDOW
+  config.headless = true;
+#endif
+  
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "--headless") == 0){
+      config.headless = true;
+    }
+    else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc){
+      config.maxSteps = atoll(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--render-every") == 0 && i + 1 < argc){
+      config.renderEvery = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc){
+      seedRandom(strtoull(argv[++i], nullptr, 10));
+    }
+    else if (strcmp(argv[i], "--stats") == 0){
+      options.printStats = true;
+    }
+    else if (strcmp(argv[i], "--async-output") == 0){
+      options.asyncOutput = true;
+    }
+    else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc){
+      sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+    }
+    else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc){
+      options.dumpPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--hashes") == 0){
+      options.printHashes = true;
+    }
+    else if (strcmp(argv[i], "--full-redraw") == 0){
+      options.fullRedraw = true;
+    }
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc){
+      options.recordPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile") == 0){
+      options.profile = true;
+    }
+    else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+      options.tracePath = argv[++i];
+    }
+  }
+  
+  Profiler::setEnabled(options.profile);
+  if (!options.tracePath.empty()){
+    Trace::start(options.tracePath);
+    signal(SIGUSR1, onTraceSignal);
+  }
+  Recorder recorder;
+  if (!options.recordPath.empty()) recorder.open(options.recordPath);
+  LatencyHistogram inputLatency = runGame(config, options, recorder);
+  recorder.close();
+  Trace::stop();
+  
+  if (options.printStats && !options.recordPath.empty()){
+    std::cout << "recorded " << recorder.frames() << " frames, " << recorder.dropped() << " dropped\n";
+  }
+  
+#ifndef NO_WINDOW
+  if (options.printStats){
+    tb_stats stats;
+    tb_get_stats(&stats);
+    std::cout << "terminal output: " << stats.total_bytes << " bytes over " << stats.presents << " frames, "
+              << (stats.presents ? stats.total_bytes / stats.presents : 0) << " bytes/frame, "
+              << stats.skipped << " skipped, max write " << stats.max_write_us << "us\n";
+  }
+#endif
+  if (options.printStats){
+    // The output thread does the write(), so the clock stops when the frame is handed to it
+    std::cout << "input latency" << (options.asyncOutput ? " (to hand-off)" : "") << ": " << inputLatency.summary() << "\n";
+  }
+  if (options.printStats && Profiler::enabled()){
+    for (const auto& line: Profiler::summary()) std::cout << "profile " << line << "\n";
+  }
   return 0;
 }
 
@@ -32,6 +156,7 @@ int main(int argc, const char * argv[]) {
 
 Window* window {nullptr};
 Game* game {nullptr};
+GameLoop* loop {nullptr};
 
 EM_BOOL emsKeyDownCallback(int eventType, const EmscriptenKeyboardEvent* e, void* userData){
   return window->emsKeyDownCallback(eventType, e, userData);
@@ -50,13 +175,11 @@ extern "C" {
       window = new Window;
       game = new Game{*window};
       game->setup();
+      loop = new GameLoop{*window, *game, GameLoop::Config {}};
     }
 
     void EMSCRIPTEN_KEEPALIVE _update() {
-      window->handleEvents();
-      game->update();
-      game->render();
-      window->render();
+      loop->frame();
     }
 }
 
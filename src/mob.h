@@ -71,7 +71,10 @@ public:
   
   vec2i position {0, 0};
   int32_t health {0};
-  int32_t tick {0};
+  
+  // Action energy, gains info->speed per world tick and an action costs TicksPerAction
+  int32_t energy {0};
+  int32_t energyTick {0}; // world tick energy was last brought up to date
   
   // type-specific data
   vec2i dir {0, 1};
@@ -1,8 +1,10 @@
 #include "mobsystem.h"
 
 #include "game.h"
+#include "profiler.h"
 #include "rendersystem.h"
 
+#include <cmath>
 #include <string>
 using namespace std::string_literals;
 
@@ -37,39 +39,150 @@ const std::unordered_map<MobType, MobInfo> MobDatabase {
 };
 
 void MobSystem::update(){
-  for (auto& mob: game_.mobs.values()){
-    if (mob.info->category == MobCategory::Player) continue;
+  PROFILE_ZONE("mobs");
+  const uint32_t now = game_.worldTick();
+  lodStats_ = {};
+  
+  // Far mobs that missed their turn go first, longest waiting first
+  while (!farBacklog_.empty() && lodStats_.far < FarBudgetPerTick){
+    auto& mob = game_.mobs[farBacklog_.front()];
+    farBacklog_.pop_front();
+    if (!mob) continue; // Removed while waiting
+    
+    // Owed one coarse update however long it waited, rather than one big jump
+    mob.energy = FarActions * Mob::TicksPerAction;
+    mob.energyTick = now;
+    act(mob, now, lod(mob));
+  }
+  
+  // Only mobs whose turn has come are touched
+  actions_.popUntil(now, [this, now](ident id){
+    auto& mob = game_.mobs[id];
+    if (!mob) return; // Removed since it was scheduled
     
-    mob.tick += mob.info->speed;
-    mob.tick = std::min(mob.tick, 2 * Mob::TicksPerAction - 1);
-    if (mob.tick >= Mob::TicksPerAction){
-      auto& e = game_.entities[mob.entity];
-      updateMob(e, mob);
-      mob.tick -= Mob::TicksPerAction;
+    MobLod tier = lod(mob);
+    if (tier == MobLod::Far && lodStats_.far >= FarBudgetPerTick){
+      // Over budget, it waits in line and is off the queue until served
+      farBacklog_.push_back(id);
+      lodStats_.deferred++;
+      return;
     }
+    act(mob, now, tier);
+  });
+  
+  lodTotals_.near     += lodStats_.near;
+  lodTotals_.far      += lodStats_.far;
+  lodTotals_.deferred += lodStats_.deferred;
+}
+
+void MobSystem::act(Mob& mob, uint32_t now, MobLod tier){
+  // Bring energy up to date
+  mob.energy += ((int) now - mob.energyTick) * mob.info->speed;
+  mob.energyTick = now;
+  
+  // Whole actions owed since the last update
+  const int actions = std::max(1, mob.energy / Mob::TicksPerAction);
+  mob.energy -= actions * Mob::TicksPerAction;
+  
+  auto& e = game_.entities[mob.entity];
+  if (tier == MobLod::Near){
+    // Actions missed while far away are dropped, the mob resumes from where it is
+    updateMob(e, mob);
+    schedule(mob);
+    lodStats_.near++;
+  }
+  else {
+    updateMobFar(e, mob, actions);
+    schedule(mob, FarActions);
+    lodStats_.far++;
   }
 }
 
+void MobSystem::setup(){
+  const auto& b = game_.worldBounds;
+  occupancy_.resize(b.width, b.height);
+  occupancy_.fill(0);
+}
+
+void MobSystem::add(Mob& mob){
+  occupy(mob.position, 1);
+  
+  if (mob.info->category == MobCategory::Player) return; // Driven by input
+  if (mob.info->speed <= 0) return; // Never gains energy, so never acts
+  
+  mob.energy = 0;
+  mob.energyTick = game_.worldTick();
+  schedule(mob, lod(mob) == MobLod::Near ? 1 : FarActions);
+}
+
+void MobSystem::schedule(Mob& mob, int actions){
+  // Due on the first tick energy covers the actions
+  const int speed = mob.info->speed;
+  const int wait = std::max(1, (actions * Mob::TicksPerAction - mob.energy + speed - 1) / speed);
+  mob.energyTick += wait;
+  mob.energy += wait * speed;
+  actions_.push(mob.energyTick, mob.id);
+}
+
+void MobSystem::remove(const Mob& mob){
+  occupy(mob.position, -1);
+}
+
+vec2i MobSystem::cell(vec2i p) const {
+  const auto& b = game_.worldBounds;
+  return {p.x - b.left, b.top - p.y};
+}
+
+void MobSystem::occupy(vec2i p, int delta){
+  vec2i q = cell(p);
+  if (!occupancy_.inBounds(q)) return;
+  uint8_t& n = occupancy_(q);
+  if (delta > 0 && n < UINT8_MAX) n++;
+  else if (delta < 0 && n > 0) n--;
+}
+
+int MobSystem::occupants(vec2i p) const {
+  vec2i q = cell(p);
+  return occupancy_.inBounds(q) ? occupancy_(q) : 0;
+}
+
+MobLod MobSystem::lod(const Mob& mob) const {
+  const vec2i d = mob.position - game_.cameraPosition;
+  const int rx = game_.window.width()  / 2 + NearMargin;
+  const int ry = game_.window.height() / 2 + NearMargin;
+  return (std::abs(d.x) <= rx && std::abs(d.y) <= ry) ? MobLod::Near : MobLod::Far;
+}
+
+vec2i MobSystem::dirToNearestEdge(vec2i pos) const {
+  const int margin = 6; // min distance from edge mobs prefer to be
+  const auto& b = game_.worldBounds;
+  
+  if (pos.y > b.top - margin) return {0, -1};
+  else if (pos.y < b.top - b.height + margin) return {0, 1};
+  else if (pos.x < b.left + margin) return {1, 0};
+  else if (pos.x > b.left + b.width - margin) return {-1, 0};
+  return {0, 0};
+}
+
 void MobSystem::handleEvent(const EvAny& any) {
+  auto& r = rng(RngStream::Mobs);
   if (any.is<EvTryWalk>()){
     const auto& ev = any.get<EvTryWalk>();
     auto& mob = game_.mobs[ev.mob];
     auto& info = *mob.info;
     
-    // check position is clear
-    bool blocked = false;
-    for (auto& other: game_.mobs.values()){
-      if (other.id != mob.id && other.position == ev.to){
-        blocked = true;
-        break;
-      }
-    }
+    // check position is clear (of anyone but this mob)
+    // Only the destination is checked, so a far mob's multi-cell move can pass
+    // through others; it's off screen, where that can't be seen
+    bool blocked = occupants(ev.to) > (ev.to == mob.position ? 1 : 0);
     
     if (!game_.worldBounds.contains(ev.to)){
       blocked = true;
     }
     
     if (!blocked){
+      occupy(mob.position, -1);
+      occupy(ev.to, 1);
       mob.position = ev.to;
       
       // Mob overrides sprite position
@@ -80,17 +193,17 @@ void MobSystem::handleEvent(const EvAny& any) {
       switch (info.category){
         default: break;
         case MobCategory::Snake: {
-          if (randInt(0, 3) < 3){
-            game_.groundTile(mob.position) = '_';
+          if (randInt(r, 0, 3) < 3){
+            game_.setGroundTile(mob.position, '_');
           }
           
           game_.sprites[mob.extraSprite].position = mob.position + mob.dir;
           break;
         }
         case MobCategory::Orc: {
-          if (randInt(0, 1) == 0){
+          if (randInt(r, 0, 1) == 0){
             // smash ground
-            game_.groundTile(mob.position) = '_';
+            game_.setGroundTile(mob.position, '_');
           }
           game_.sprites[mob.extraSprite].position  = mob.position + vec2i{-1, 1};
           game_.sprites[mob.extraSprite2].position = mob.position + vec2i{1, 1};
@@ -98,7 +211,7 @@ void MobSystem::handleEvent(const EvAny& any) {
         }
       }
       
-      game_.queueEvent(EvWalked { mob.id, ev.from, mob.position });
+      game_.queueEvent(EvWalked { mob.id, ev.from, mob.position, ev.inputStamp });
     }
   }
   else if (any.is<EvWalked>()){
@@ -119,10 +232,11 @@ void MobSystem::handleEvent(const EvAny& any) {
       else {
         // Flash-hit
         const int flashDuration = 2;
+        const int clock = animClock(game_.worldTick());
         auto& e = game_.entities[targetMob.entity];
-        game_.sprites[e.sprite].flashTimer = flashDuration;
-        if (targetMob.extraSprite)  game_.sprites[targetMob.extraSprite].flashTimer  = flashDuration;
-        if (targetMob.extraSprite2) game_.sprites[targetMob.extraSprite2].flashTimer = flashDuration;
+        game_.sprites[e.sprite].flash(clock, flashDuration);
+        if (targetMob.extraSprite)  game_.sprites[targetMob.extraSprite].flash(clock, flashDuration);
+        if (targetMob.extraSprite2) game_.sprites[targetMob.extraSprite2].flash(clock, flashDuration);
       }
     }
   }
@@ -132,21 +246,11 @@ void MobSystem::updateMob(Entity& e, Mob& mob){
   auto& info = *mob.info;
   auto& sprite = game_.sprites[e.sprite];
   vec2i pos = mob.position;
-  
-  const int margin = 6; // min distance from edge mobs prefer to be
-  auto dirToNearestEdge = [&](vec2i pos) -> vec2i {
-    const auto& b = game_.worldBounds;
-    
-    if (pos.y > b.top - margin) return {0, -1};
-    else if (pos.y < b.top - b.height + margin) return {0, 1};
-    else if (pos.x < b.left + margin) return {1, 0};
-    else if (pos.x > b.left + b.width - margin) return {-1, 0};
-    return {0, 0};
-  };
+  auto& r = rng(RngStream::Mobs);
   
   switch (info.category){
     case MobCategory::Rabbit: {
-      if (randInt(0, 500) == 0){
+      if (randInt(r, 0, 500) == 0){
         // Too many rabbits!
         // game_.queueEvent(EvSpawnMob { MobType::Rabbit, pos });
       }
@@ -154,19 +258,19 @@ void MobSystem::updateMob(Entity& e, Mob& mob){
         // Move randomly
         vec2i dir = dirToNearestEdge(pos);
         if (dir == vec2i{0,0}){
-          dir = vec2i {randInt(-1, 1), randInt(-1, 1)};
+          dir = vec2i {randInt(r, -1, 1), randInt(r, -1, 1)};
         }
         game_.queueEvent(EvTryWalk { mob.id, pos, pos + dir } );
       }
       break;
     }
     case MobCategory::Snake: {
-      if (randInt(0, 6) == 0){
+      if (randInt(r, 0, 6) == 0){
         if (mob.dir.x != 0){
-          mob.dir = choose<vec2i>({{0, 1}, {0, -1}});
+          mob.dir = choose<vec2i>(r, {{0, 1}, {0, -1}});
         }
         else {
-          mob.dir = choose<vec2i>({{1, 0}, {-1, 0}});
+          mob.dir = choose<vec2i>(r, {{1, 0}, {-1, 0}});
         }
         
         vec2i dir = dirToNearestEdge(pos);
@@ -183,19 +287,19 @@ void MobSystem::updateMob(Entity& e, Mob& mob){
       break;
     }
     case MobCategory::Orc: {
-      if (randInt(0, 2) == 0){
-        game_.groundTile(pos) = choose({'_','_'});
+      if (randInt(r, 0, 2) == 0){
+        game_.setGroundTile(pos, choose(r, {'_','_'}));
       }
       
       vec2i dir = dirToNearestEdge(pos);
       if (dir == vec2i{0,0}){
-        if (randInt(0, 3) == 0){
+        if (randInt(r, 0, 3) == 0){
           // stay here
         }
         else {
           // move randomly
-          int32_t move = choose({-1, 1});
-          dir = choose({vec2i{move, 0}, vec2i{0, move}});
+          int32_t move = choose(r, {-1, 1});
+          dir = choose(r, {vec2i{move, 0}, vec2i{0, move}});
         }
       }
       
@@ -208,3 +312,65 @@ void MobSystem::updateMob(Entity& e, Mob& mob){
   }
 }
 
+void MobSystem::updateMobFar(Entity& e, Mob& mob, int actions){
+  auto& info = *mob.info;
+  const vec2i pos = mob.position;
+  auto& r = rng(RngStream::Mobs);
+  
+  // Displacement of an n-step random walk, drawn uniformly with matching variance
+  auto walk = [&r](int n, double variancePerStep) -> int {
+    int spread = (int) std::lround((-1.0 + std::sqrt(1.0 + 12.0 * n * variancePerStep)) / 2.0);
+    return randInt(r, -spread, spread);
+  };
+  
+  vec2i dir = dirToNearestEdge(pos);
+  vec2i to = pos;
+  if (dir != vec2i{0,0}){
+    to = pos + dir * actions;
+  }
+  else {
+    switch (info.category){
+      case MobCategory::Rabbit: {
+        to = pos + vec2i {walk(actions, 2.0 / 3.0), walk(actions, 2.0 / 3.0)};
+        break;
+      }
+      case MobCategory::Snake: {
+        // Turns on 1 in 7 actions, otherwise keeps going
+        int steps = actions;
+        if (random(r, 0.0, 1.0) > std::pow(6.0 / 7.0, actions)){
+          mob.dir = (mob.dir.x != 0) ? choose<vec2i>(r, {{0, 1}, {0, -1}}) : choose<vec2i>(r, {{1, 0}, {-1, 0}});
+          steps--;
+        }
+        to = pos + mob.dir * steps;
+        break;
+      }
+      case MobCategory::Orc: {
+        if (randInt(r, 0, 2) == 0){
+          game_.setGroundTile(pos, '_');
+        }
+        // Moves one cell along an axis on 3 in 4 actions
+        to = pos + vec2i {walk(actions, 3.0 / 8.0), walk(actions, 3.0 / 8.0)};
+        break;
+      }
+      default: break;
+    }
+  }
+  
+  if (info.category == MobCategory::Snake){
+    auto& sprite = game_.sprites[e.sprite];
+    if (mob.dir.y == 1) sprite.frame = 0;
+    else if (mob.dir.y == -1) sprite.frame = 1;
+    else if (mob.dir.x == 1) sprite.frame = 2;
+    else if (mob.dir.x == -1) sprite.frame = 3;
+  }
+  
+  // Keep within the world
+  const auto& b = game_.worldBounds;
+  to.x = std::max(b.left, std::min(to.x, b.left + b.width - 1));
+  to.y = std::max(b.top - b.height + 1, std::min(to.y, b.top));
+  
+  // Only the destination has to be clear, see handleEvent
+  if (to != pos){
+    game_.queueEvent(EvTryWalk { mob.id, pos, to } );
+  }
+}
@@ -1,25 +1,65 @@
 #ifndef mobsystem_hpp
 #define mobsystem_hpp
 
+#include "actionqueue.h"
 #include "entity.h"
 #include "mob.h"
 #include "system.h"
 #include "util.h"
 
+#include <deque>
+
 extern const std::unordered_map<MobType, MobInfo> MobDatabase;
 
+// Mobs near the camera are simulated action by action, distant mobs are
+// updated every FarActions actions with an aggregate movement model
+enum class MobLod {
+  Near,
+  Far,
+};
+
+struct MobLodStats {
+  int near = 0;     // mobs updated per action
+  int far = 0;      // mobs updated with the coarse model
+  int deferred = 0; // far mobs that went to the backlog over the budget
+};
+
 class Game;
 class MobSystem: public System {
 public:
+  static const int FarActions = 4;         // actions per coarse update
+  static const int NearMargin = 32;        // cells beyond the screen edge still simulated in full
+  static const int FarBudgetPerTick = 256; // max coarse updates per world tick
+  
   MobSystem(Game& game):game_(game){}
   void update() final;
   void handleEvent(const EvAny&) final;
   
+  void setup();                 // sizes the occupancy grid to worldBounds, before any mob is added
+  void add(Mob& mob);           // schedules the first action of a new mob
+  void remove(const Mob& mob);  // as the mob leaves the world
+  int occupants(vec2i p) const; // mobs standing on p
+  
+  const MobLodStats& lodStats() const { return lodStats_; }       // last world tick
+  const MobLodStats& lodTotals() const { return lodTotals_; }     // since startup
+  
 protected:
+  MobLod lod(const Mob& mob) const;
+  void act(Mob& mob, uint32_t now, MobLod tier);
   void updateMob(Entity& e, Mob& mob);
+  void updateMobFar(Entity& e, Mob& mob, int actions);
+  void schedule(Mob& mob, int actions = 1);
+  vec2i dirToNearestEdge(vec2i pos) const;
+  void occupy(vec2i p, int delta);
+  vec2i cell(vec2i p) const; // world point to occupancy grid cell
   
 protected:
   Game& game_;
+  ActionQueue<ident> actions_;
+  std::deque<ident> farBacklog_ {}; // far mobs past their turn, over the budget
+  MobLodStats lodStats_ {};
+  MobLodStats lodTotals_ {};
+  Array2D<uint8_t> occupancy_ {0, 0}; // mobs per world cell, rows from worldBounds.top down
 };
 
 #endif /* mobsystem_hpp */
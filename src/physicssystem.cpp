@@ -1,8 +1,10 @@
 #include "physicssystem.h"
 
 #include "game.h"
+#include "profiler.h"
 
 void PhysicsSystem::update(){
+  PROFILE_ZONE("physics");
   for (auto& ph: game_.physics.values()){
     if (ph.type == PhysicsType::Projectile){
       ph.position += ph.velocity;
@@ -0,0 +1,70 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+bool Profiler::enabled_ = false;
+
+ProfileZone::ProfileZone(const char* name):name_(name){
+  Profiler::zones_().push_back(this);
+}
+
+void ProfileZone::endFrame(){
+  ring_[ringNext_] = current_;
+  ringNext_ = (ringNext_ + 1) % RingSize;
+  ringCount_ = std::min(ringCount_ + 1, (int) RingSize);
+
+  total_ += current_;
+  frames_++;
+  worstAll_ = std::max(worstAll_, current_);
+  current_ = 0;
+}
+
+void ProfileZone::reset(){
+  current_ = 0;
+  ringNext_ = ringCount_ = 0;
+  total_ = frames_ = worstAll_ = 0;
+}
+
+int64_t ProfileZone::average() const {
+  if (ringCount_ == 0) return 0;
+  int64_t sum = 0;
+  for (int i = 0; i < ringCount_; i++) sum += ring_[i];
+  return sum / ringCount_;
+}
+
+int64_t ProfileZone::worst() const {
+  int64_t worst = 0;
+  for (int i = 0; i < ringCount_; i++) worst = std::max(worst, ring_[i]);
+  return worst;
+}
+
+void Profiler::setEnabled(bool enabled){
+  if (enabled && !enabled_){
+    for (auto* zone: zones_()) zone->reset();
+  }
+  enabled_ = enabled;
+}
+
+void Profiler::endFrame(){
+  if (!enabled_) return;
+  for (auto* zone: zones_()) zone->endFrame();
+}
+
+static std::string zoneLine(const char* name, int64_t average, int64_t worst){
+  char line[96];
+  snprintf(line, sizeof(line), "%-10s avg %7.3fms  worst %7.3fms", name, average / 1e6, worst / 1e6);
+  return line;
+}
+
+std::vector<std::string> Profiler::overlay(){
+  std::vector<std::string> lines;
+  for (auto* zone: zones_()) lines.push_back(zoneLine(zone->name(), zone->average(), zone->worst()));
+  return lines;
+}
+
+std::vector<std::string> Profiler::summary(){
+  std::vector<std::string> lines;
+  for (auto* zone: zones_()) lines.push_back(zoneLine(zone->name(), zone->averageAll(), zone->worstAll()));
+  return lines;
+}
@@ -0,0 +1,103 @@
+#ifndef profiler_hpp
+#define profiler_hpp
+
+#include "trace.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped-timer profiler
+// PROFILE_ZONE("name") times the rest of the enclosing scope. Each zone sums its
+// time over a frame and keeps the last RingSize frames, for rolling averages and
+// the worst frame. Switched off at runtime a zone costs a branch, and building
+// with NO_PROFILER removes the zones altogether.
+
+class ProfileZone {
+public:
+  static const int RingSize = 128;
+
+  explicit ProfileZone(const char* name); // registers with the Profiler
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+  const char* name() const { return name_; }
+  void add(int64_t ns){ current_ += ns; }
+
+  void endFrame();
+  void reset();
+
+  int64_t average() const; // ns per frame over the ring
+  int64_t worst() const;   // ns in the worst frame in the ring
+  int64_t averageAll() const { return frames_ ? total_ / frames_ : 0; }
+  int64_t totalAll() const { return total_; }
+  int64_t worstAll() const { return worstAll_; }
+
+protected:
+  const char* name_;
+  int64_t current_ = 0;
+  std::array<int64_t, RingSize> ring_ {};
+  int ringNext_ = 0;
+  int ringCount_ = 0;
+
+  // Since the profiler was switched on
+  int64_t total_ = 0;
+  int64_t frames_ = 0;
+  int64_t worstAll_ = 0;
+};
+
+class Profiler {
+public:
+  static bool enabled() { return enabled_; }
+  static void setEnabled(bool enabled); // switching on starts the zones afresh
+
+  static void endFrame(); // once per frame, after it's presented
+
+  static const std::vector<ProfileZone*>& zones() { return zones_(); }
+  static std::vector<std::string> overlay(); // a line per zone, rolling average and worst
+  static std::vector<std::string> summary(); // a line per zone, since switched on
+
+protected:
+  static std::vector<ProfileZone*>& zones_(){
+    static std::vector<ProfileZone*> zones;
+    return zones;
+  }
+
+  static bool enabled_;
+  friend class ProfileZone;
+};
+
+// Times into its zone, and is a span in the trace when one's being taken
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileZone& zone):zone_(Profiler::enabled() || Trace::enabled() ? &zone : nullptr){
+    if (zone_) start_ = Trace::now();
+  }
+
+  ~ProfileScope(){
+    if (!zone_) return;
+    int64_t duration = Trace::now() - start_;
+    if (Profiler::enabled()) zone_->add(duration);
+    if (Trace::enabled()) Trace::span(zone_->name(), start_, duration);
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+protected:
+  ProfileZone* zone_;
+  int64_t start_ = 0;
+};
+
+#ifdef NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) \
+  static ProfileZone PROFILE_CONCAT(profileZone_, __LINE__) {name}; \
+  ProfileScope PROFILE_CONCAT(profileScope_, __LINE__) {PROFILE_CONCAT(profileZone_, __LINE__)}
+#endif
+
+#endif /* profiler_hpp */
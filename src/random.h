@@ -0,0 +1,147 @@
+#ifndef random_hpp
+#define random_hpp
+
+#include <cstdint>
+#include <limits>
+
+// xoshiro128++ generator
+// small and fast, with independent streams derived from (seed, stream)
+// via splitmix64; also usable as a UniformRandomBitGenerator
+class Rng {
+public:
+  using result_type = uint32_t;
+
+  explicit Rng(uint64_t seed = DefaultSeed, uint64_t stream = 0){
+    reseed(seed, stream);
+  }
+
+  void reseed(uint64_t seed, uint64_t stream = 0){
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    for (auto& s: s_){
+      s = (uint32_t) (splitmix64(x) >> 32);
+    }
+  }
+
+  // 32 random bits
+  uint32_t next(){
+    const uint32_t result = rotl(s_[0] + s_[3], 7) + s_[0];
+    const uint32_t t = s_[1] << 9;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 11);
+    return result;
+  }
+
+  // uniform in [0, range) without division on the fast path (Lemire's method)
+  uint32_t bounded(uint32_t range){
+    uint64_t m = uint64_t(next()) * range;
+    uint32_t low = (uint32_t) m;
+    if (low < range){
+      const uint32_t threshold = (0u - range) % range;
+      while (low < threshold){
+        m = uint64_t(next()) * range;
+        low = (uint32_t) m;
+      }
+    }
+    return (uint32_t) (m >> 32);
+  }
+
+  // uniform in [from, to]
+  int32_t range(int32_t from, int32_t to){
+    const uint32_t span = uint32_t(to) - uint32_t(from) + 1;
+    if (span == 0) return (int32_t) next(); // full 32-bit range
+    return (int32_t) (uint32_t(from) + bounded(span));
+  }
+
+  // uniform in [0, 1)
+  double uniform(){
+    return next() * (1.0 / 4294967296.0);
+  }
+
+  double uniform(double from, double to){
+    return from + (to - from) * uniform();
+  }
+
+  result_type operator()() { return next(); }
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+  static constexpr uint64_t DefaultSeed = 0x853C49E6748FEA9Bull;
+
+protected:
+  static uint32_t rotl(uint32_t x, int k){
+    return (x << k) | (x >> (32 - k));
+  }
+
+  static uint64_t splitmix64(uint64_t& x){
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+protected:
+  uint32_t s_[4];
+};
+
+// named streams, one set per thread, so systems don't perturb each other's sequences
+enum class RngStream {
+  Default,
+  World,   // terrain generation and upkeep
+  Mobs,    // mob behaviour
+  Effects, // particles, camera shake
+  Render,  // animation phases, ocean pattern
+
+  Count
+};
+
+// seed shared by every stream (and every thread), set before use for reproducible runs
+inline uint64_t& rngSeed(){
+  static uint64_t seed_ = Rng::DefaultSeed;
+  return seed_;
+}
+
+// the streams of one thread, keyed by a worker index the thread is given rather
+// than the order threads start in, so runs repeat however they're scheduled;
+// the main thread is worker 0, and the index is mixed into the stream numbers
+struct RngStreams {
+  RngStreams(){
+    reseed(rngSeed());
+  }
+  
+  void reseed(uint64_t seed){
+    for (int i = 0; i < (int) RngStream::Count; i++){
+      streams[i].reseed(seed, worker * (uint64_t) RngStream::Count + i);
+    }
+  }
+  
+  uint64_t worker = 0;
+  Rng streams[(int) RngStream::Count];
+};
+
+inline RngStreams& rngStreams(){
+  thread_local RngStreams streams_;
+  return streams_;
+}
+
+inline Rng& rng(RngStream stream = RngStream::Default){
+  return rngStreams().streams[(int) stream];
+}
+
+// reseeds every stream of the calling thread
+inline void seedRandom(uint64_t seed){
+  rngSeed() = seed;
+  rngStreams().reseed(seed);
+}
+
+// call first thing in any other thread that draws, with an index no other thread
+// uses (1 up), or it repeats the main thread's sequences
+inline void setRngWorker(int worker){
+  rngStreams().worker = (uint64_t) worker;
+  rngStreams().reseed(rngSeed());
+}
+
+#endif /* random_hpp */
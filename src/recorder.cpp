@@ -0,0 +1,222 @@
+#include "recorder.h"
+
+#include "termbox.h"
+
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <pthread.h>
+
+// Frames are dropped rather than queued past this, the next one carries their changes
+static const size_t MaxPending = 16 << 20;
+
+Recorder::~Recorder(){
+  close();
+}
+
+bool Recorder::open(const std::string& path){
+  close();
+
+  const std::string gz = ".gz";
+  piped_ = path.size() > gz.size() && path.compare(path.size() - gz.size(), gz.size(), gz) == 0;
+  if (piped_){
+    std::string quoted = "'";
+    for (char c: path){
+      if (c == '\'') quoted += "'\\''";
+      else quoted += c;
+    }
+    quoted += "'";
+    out_ = popen(("gzip -c > " + quoted).c_str(), "w");
+  }
+  else {
+    out_ = fopen(path.c_str(), "wb");
+  }
+
+  if (!out_){
+    std::cerr << "can't record to " << path << "\n";
+    return false;
+  }
+
+  path_ = path;
+  start_ = std::chrono::steady_clock::now();
+  last_.clear();
+  width_ = height_ = 0;
+  frames_ = dropped_ = 0;
+  pending_.clear();
+  quit_ = false;
+  failed_ = false;
+  writer_ = std::thread(&Recorder::writerMain, this);
+  return true;
+}
+
+void Recorder::close(){
+  if (!out_) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+
+  // Reported here, once the terminal is back to normal
+  bool closed = piped_ ? pclose(out_) == 0 : fclose(out_) == 0;
+  if (failed_ || !closed){
+    std::cerr << "recording to " << path_ << " failed, it stops after " << frames_ << " frames\n";
+  }
+  out_ = nullptr;
+}
+
+void Recorder::frame(const Cell* cells, int width, int height){
+  if (!out_) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_) return;
+    if (pending_.size() > MaxPending){
+      dropped_++;
+      return;
+    }
+  }
+
+  using seconds = std::chrono::duration<double>;
+  double time = std::chrono::duration_cast<seconds>(std::chrono::steady_clock::now() - start_).count();
+  char number[64];
+  std::string lines;
+  text_.clear();
+
+  if (width != width_ || height != height_){
+    if (width_ == 0){
+      snprintf(number, sizeof(number), "%lld", (long long) std::time(nullptr));
+      lines += "{\"version\": 2, \"width\": " + std::to_string(width) + ", \"height\": " + std::to_string(height)
+             + ", \"timestamp\": " + number + ", \"env\": {\"TERM\": \"xterm-256color\"}}\n";
+      text_ += "\\u001b[?25l"; // hide the cursor
+    }
+    else {
+      snprintf(number, sizeof(number), "%.6f", time);
+      lines += std::string("[") + number + ", \"r\", \"" + std::to_string(width) + "x" + std::to_string(height) + "\"]\n";
+    }
+
+    // Nothing recorded matches, so every cell is sent
+    width_ = width;
+    height_ = height;
+    last_.assign(width * height, Cell {UINT32_MAX, 0, 0});
+    cursorX_ = cursorY_ = -1;
+    colours_ = UINT32_MAX;
+  }
+
+  encode(cells, width, height);
+  if (!text_.empty()){
+    snprintf(number, sizeof(number), "%.6f", time);
+    lines += std::string("[") + number + ", \"o\", \"" + text_ + "\"]\n";
+  }
+  if (lines.empty()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ += lines;
+  }
+  wake_.notify_one();
+  frames_++;
+}
+
+void Recorder::encode(const Cell* cells, int width, int height){
+  // text_ is built already escaped for a JSON string
+  for (int y = 0; y < height; y++){
+    const Cell* row = cells + y * width;
+    Cell* last = &last_[y * width];
+    if (std::memcmp(row, last, width * sizeof(Cell)) == 0) continue;
+
+    for (int x = 0; x < width; x++){
+      if (row[x] == last[x]) continue;
+      moveTo(x, y);
+      setColours(row[x].fg, row[x].bg);
+      putGlyph(row[x].ch);
+      last[x] = row[x];
+    }
+  }
+}
+
+void Recorder::moveTo(int x, int y){
+  if (x == cursorX_ && y == cursorY_) return;
+  text_ += "\\u001b[" + std::to_string(y + 1) + ";" + std::to_string(x + 1) + "H";
+  cursorX_ = x;
+  cursorY_ = y;
+}
+
+void Recorder::setColours(uint16_t fg, uint16_t bg){
+  uint32_t colours = fg | (uint32_t) bg << 16;
+  if (colours == colours_) return;
+  colours_ = colours;
+
+  // termbox colours are 1-based, 0 is the terminal's default
+  auto colour = [&](int base, uint16_t c){
+    c &= 0xFF;
+    if (c == 0) text_ += ";" + std::to_string(base + 9);
+    else if (c <= 8) text_ += ";" + std::to_string(base + c - 1);
+    else text_ += ";" + std::to_string(base + 8) + ";5;" + std::to_string(c - 1);
+  };
+
+  text_ += "\\u001b[0";
+  if (fg & TB_BOLD) text_ += ";1";
+  if ((fg | bg) & TB_UNDERLINE) text_ += ";4";
+  if ((fg | bg) & TB_REVERSE) text_ += ";7";
+  colour(30, fg);
+  colour(40, bg);
+  text_ += "m";
+}
+
+void Recorder::putGlyph(uint32_t ch){
+  if (ch < 32 || ch == 127) text_ += ' ';
+  else if (ch == '"') text_ += "\\\"";
+  else if (ch == '\\') text_ += "\\\\";
+  else if (ch < 128) text_ += (char) ch;
+  else if (ch < 0x800){
+    text_ += (char) (0xC0 | ch >> 6);
+    text_ += (char) (0x80 | (ch & 0x3F));
+  }
+  else if (ch < 0x10000){
+    text_ += (char) (0xE0 | ch >> 12);
+    text_ += (char) (0x80 | (ch >> 6 & 0x3F));
+    text_ += (char) (0x80 | (ch & 0x3F));
+  }
+  else {
+    text_ += (char) (0xF0 | (ch >> 18 & 0x07));
+    text_ += (char) (0x80 | (ch >> 12 & 0x3F));
+    text_ += (char) (0x80 | (ch >> 6 & 0x3F));
+    text_ += (char) (0x80 | (ch & 0x3F));
+  }
+
+  // Past the last column the terminal holds off wrapping, so the cursor is in limbo
+  if (++cursorX_ >= width_) cursorX_ = -1;
+}
+
+void Recorder::writerMain(){
+  // If gzip is gone the writes fail with EPIPE, instead of SIGPIPE killing the game
+  sigset_t pipe;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+
+  std::string writing;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;){
+    wake_.wait(lock, [this](){ return quit_ || !pending_.empty(); });
+    if (pending_.empty()) break; // quitting with nothing left
+
+    writing.swap(pending_);
+    lock.unlock();
+    bool written = fwrite(writing.data(), 1, writing.size(), out_) == writing.size() && fflush(out_) == 0;
+    writing.clear();
+    lock.lock();
+
+    // Stop taking frames, close() says why
+    if (!written){
+      failed_ = true;
+      pending_.clear();
+      break;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef recorder_hpp
+#define recorder_hpp
+
+#include "framebuffer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records rendered frames as an asciicast v2 file
+// Each frame is diffed against the last one recorded and only the changed cells
+// are encoded, as cursor moves, colours and glyphs; the events are handed to a
+// writer thread so the game thread never touches the disk.
+// Paths ending in .gz are piped through gzip, which compresses in its own process.
+// If writing fails recording stops, and close() reports it.
+class Recorder {
+public:
+  Recorder() = default;
+  ~Recorder();
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  bool open(const std::string& path);
+  void close(); // waits for everything to be written
+  bool isOpen() const { return out_ != nullptr; }
+
+  // Called once per rendered frame with the whole screen, rows top to bottom
+  void frame(const Cell* cells, int width, int height);
+
+  int64_t frames() const { return frames_; }
+  int64_t dropped() const { return dropped_; } // skipped while the writer was too far behind
+
+protected:
+  void encode(const Cell* cells, int width, int height);
+  void moveTo(int x, int y);
+  void setColours(uint16_t fg, uint16_t bg);
+  void putGlyph(uint32_t ch);
+  void writerMain();
+
+protected:
+  FILE* out_ = nullptr;
+  std::string path_ {};
+  bool piped_ = false;
+  std::chrono::steady_clock::time_point start_ {};
+
+  // Screen as last recorded, and where the player's cursor and colours were left
+  std::vector<Cell> last_ {};
+  int width_ = 0;
+  int height_ = 0;
+  int cursorX_ = -1;
+  int cursorY_ = -1;
+  uint32_t colours_ = UINT32_MAX; // fg | bg << 16, unknown to start with
+  std::string text_ {};           // escapes for the frame being encoded
+
+  // Event lines waiting for the writer
+  std::thread writer_ {};
+  std::mutex mutex_ {};
+  std::condition_variable wake_ {};
+  std::string pending_ {};
+  bool quit_ = false;
+  bool failed_ = false; // a write failed, nothing more is recorded
+
+  int64_t frames_ = 0;
+  int64_t dropped_ = 0;
+};
+
+#endif /* recorder_hpp */
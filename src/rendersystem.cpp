@@ -2,150 +2,298 @@
 
 #include "game.h"
 
-RenderSystem::RenderSystem(Game& game):game_(game), randomArray2D_(64, 64, 0){
+#include <climits>
+
+RenderSystem::RenderSystem(Game& game):game_(game), randomArray2D_(64, 64, 0), oceanPattern_(64, 64, Cell {' ', TB_WHITE, TB_BLUE}){
   for (int& v: randomArray2D_.data()){
-    v = randInt(0, INT_MAX);
+    v = randInt(rng(RngStream::Render), 0, INT_MAX);
+  }
+  
+  // The mass only ever scrolls, so its glyphs are worked out once
+  for (int y = 0; y < randomArray2D_.height(); y++){
+    for (int x = 0; x < randomArray2D_.width(); x++){
+      if (randomArray2D_(x, y) % 16 == 0) oceanPattern_(x, y).ch = '~';
+    }
   }
 }
 
 void RenderSystem::update(){
-  const int slowBy = 2;
-  static int slowDown = 0;
-  bool updateAnimation = slowDown++ >= slowBy;
-  if (updateAnimation) slowDown = 0;
-  
   tick_++;
-  
-  for (auto& sprite: game_.sprites.values()){
-    if (updateAnimation){
-      if (sprite.animated){
-        sprite.frameCounter++;
-        if (sprite.frameCounter >= sprite.frameRate && !sprite.frames.empty()){
-          sprite.frame = (sprite.frame + 1) % sprite.frames.size();
-          sprite.frameCounter = 0;
-        }
-      }
-      
-      if (sprite.flashTimer > 0){
-        sprite.flashTimer--;
-      }
+}
+
+void RenderSystem::handleEvent(const EvAny& any){
+  if (any.is<EvRemove>()){
+    // Uncover whatever was under a removed sprite
+    const auto& ev = any.get<EvRemove>();
+    const auto& sprite = game_.sprites[game_.entities[ev.entity].sprite];
+    if (sprite && sprite.drawn){
+      markDirty(sprite.drawnPosition);
     }
   }
 }
 
+void RenderSystem::setScrollRegion(int top, int bottom){
+  scrollTop_ = top;
+  scrollBottom_ = bottom;
+}
+
+void RenderSystem::markDirty(vec2i p){
+  // Off screen as last drawn, so any pan that brings it on screen redraws it anyway
+  vec2i sc = toScreen(p);
+  if (damage_.full() || sc.x < 0 || sc.y < 0 || sc.x >= damage_.width() || sc.y >= damage_.height()) return;
+  
+  // Marked over and over with nothing rendering, the list is capped at a screenful
+  if ((int) dirtyWorld_.size() >= damage_.width() * damage_.height()){
+    damage_.markAll();
+    dirtyWorld_.clear();
+    return;
+  }
+  dirtyWorld_.push_back(p);
+}
+
 void RenderSystem::render(){
-  game_.window.clear();
+  if (fullRedraw_) damage_.markAll();
+  trackCamera();
+  trackDirty();
+  trackOcean();
+  trackSprites();
+  
+  damage_.forEachRow([&](int y, int x0, int x1){
+    frame_.reset(y, x0, x1);
+  });
   
+  // Layers composite by depth, so draw order only matters within a layer
+  renderGround();
+  renderOcean();
+  renderSprites();
+  present();
+  
+  damage_.clear();
+}
+
+void RenderSystem::present(){
+  // One span per damaged row, the overlay is drawn over it afterwards
+  cellsEmitted_ = 0;
+  damage_.forEachRow([&](int y, int x0, int x1){
+    game_.window.setRow(y, x0, frame_.row(y) + x0, x1 - x0);
+    cellsEmitted_ += x1 - x0;
+  });
+}
+
+void RenderSystem::renderSprites(){
   const recti& b = game_.worldBounds;
+  const int clock = animClock(game_.worldTick());
   
-  auto renderLayer = [&](RenderLayer layer){
-    for (const auto& sprite: game_.sprites.values()){
-      if (sprite.renderLayer == layer){
-        vec2i p = sprite.position;
-        if (game_.onScreen(p) && b.contains(p)){
-          vec2i sc = game_.screenCoord(p);
-          bool flash = sprite.flashTimer > 0;
-          game_.window.set(sc.x, sc.y, sprite.frames[sprite.frame], flash ? TB_WHITE : sprite.fg, sprite.bg);
-        }
-      }
-    }
-  };
+  for (const auto& sprite: game_.sprites.values()){
+    vec2i p = sprite.position;
+    vec2i sc = toScreen(p);
+    if (!damage_.dirty(sc.x, sc.y) || !b.contains(p)) continue;
+    uint16_t fg = sprite.flashing(clock) ? (uint16_t) TB_WHITE : sprite.fg;
+    Cell cell {(uint32_t) (unsigned char) sprite.glyph(clock), fg, sprite.bg};
+    frame_.put(sc.x, sc.y, cell, RenderDepth::of(sprite.renderLayer));
+  }
+}
+
+void RenderSystem::trackCamera(){
+  const vec2i ws { game_.window.width(), game_.window.height() };
+  if (ws.x != damage_.width() || ws.y != damage_.height()){
+    damage_.resize(ws.x, ws.y);
+    frame_.resize(ws.x, ws.y);
+  }
   
-  renderGround();
+  vec2i origin = game_.worldCoord({0, 0});
+  if (origin == lastOrigin_) return;
   
-  // Ground sprites
-  for (auto layer: { RenderLayer::Ground, RenderLayer::GroundCover }){
-    renderLayer(layer);
+  // Screen y runs opposite to world y
+  const vec2i delta {lastOrigin_.x - origin.x, origin.y - lastOrigin_.y};
+  lastOrigin_ = origin;
+  
+  // Big jumps move most cells anyway, so redraw the lot
+  const int top = std::max(scrollTop_, 0), bottom = std::min(scrollBottom_, ws.y);
+  if (damage_.full() || std::abs(delta.x) * 2 > ws.x || std::abs(delta.y) * 2 > bottom - top){
+    damage_.markAll();
+    return;
   }
   
-  renderOcean();
+  // Otherwise move what's on screen and draw what the pan uncovers
+  if (!game_.window.scroll(top, bottom, delta.x, delta.y)){
+    damage_.markAll(); // the window couldn't, e.g. mid-resize
+    return;
+  }
+  frame_.scroll(top, bottom, delta.x, delta.y);
+  damage_.markRect(0, 0, ws.x, top);
+  damage_.markRect(0, bottom, ws.x, ws.y - bottom);
+  if (delta.y > 0) damage_.markRect(0, top, ws.x, delta.y);
+  if (delta.y < 0) damage_.markRect(0, bottom + delta.y, ws.x, -delta.y);
+  if (delta.x > 0) damage_.markRect(0, top, delta.x, bottom - top);
+  if (delta.x < 0) damage_.markRect(ws.x + delta.x, top, -delta.x, bottom - top);
+}
+
+void RenderSystem::trackDirty(){
+  // Marked in world coords so they land in the right place after a pan
+  for (vec2i p: dirtyWorld_){
+    vec2i sc = game_.screenCoord(p);
+    damage_.mark(sc.x, sc.y);
+  }
+  dirtyWorld_.clear();
+}
+
+void RenderSystem::trackOcean(){
+  if (tick_ == lastOceanTick_) return;
+  bool patternMoved = lastOceanTick_ < 0 || tick_ / 32 != lastOceanTick_ / 32 || tick_ / 256 != lastOceanTick_ / 256;
+  lastOceanTick_ = tick_;
+  
+  const recti& b = game_.worldBounds;
+  
+  // Wave depth along each edge, the foreground pass runs 50 ticks ahead
+  for (int pass = 0; pass < 2; pass++){
+    int tick = pass == 1 ? tick_ + 50 : tick_;
+    double mag = cos(tick * 0.03);
+    auto profile = [&](std::vector<uint8_t>& depths, int from, int count){
+      depths.resize(count);
+      for (int i = 0; i < count; i++){
+        depths[i] = (uint8_t) (1 + (int) (2 + 2 * mag * sin(tick * 0.01 + (from + i) * 0.1)));
+      }
+    };
+    profile(waveX_[pass], b.left, b.width);
+    profile(waveY_[pass], b.top - b.height + 1, b.height);
+  }
+  const vec2i tl = game_.screenCoord({b.left, b.top});
+  const int x0 = tl.x, y0 = tl.y, x1 = x0 + b.width, y1 = y0 + b.height;
+  const int w = damage_.width(), h = damage_.height();
   
-  // Remaining sprites
-  for (auto layer: { RenderLayer::Particles, RenderLayer::MobBelow, RenderLayer::Mob, RenderLayer::MobAbove}){
-    renderLayer(layer);
+  if (patternMoved){
+    damage_.markRect(0, 0, w, y0);
+    damage_.markRect(0, y1, w, h - y1);
+    damage_.markRect(0, y0, x0, b.height);
+    damage_.markRect(x1, y0, w - x1, b.height);
   }
+  
+  // Waves reach at most this far into the world
+  const int maxDepth = 5;
+  damage_.markRect(x0, y0, b.width, maxDepth);
+  damage_.markRect(x0, y1 - maxDepth, b.width, maxDepth);
+  damage_.markRect(x0, y0, maxDepth, b.height);
+  damage_.markRect(x1 - maxDepth, y0, maxDepth, b.height);
 }
 
-void RenderSystem::renderGround(){
-  const vec2i ws { game_.window.width(), game_.window.height() };
+void RenderSystem::trackSprites(){
   const recti& b = game_.worldBounds;
+  const int w = damage_.width(), h = damage_.height();
+  const int clock = animClock(game_.worldTick());
   
-  for (int y = 0; y < ws.y; y++){
-    for(int x = 0; x < ws.x; x++){
-      vec2i p = game_.worldCoord({x, y});
-      if (game_.onScreen(p) && b.contains(p)){
-        game_.window.set(x, y, game_.groundTile(p), TB_WHITE, TB_BLACK);
+  for (auto& sprite: game_.sprites.values()){
+    vec2i p = sprite.position;
+    vec2i sc = toScreen(p);
+    bool visible = sc.x >= 0 && sc.y >= 0 && sc.x < w && sc.y < h && b.contains(p);
+    
+    // Only visible sprites work out their frame
+    char glyph = 0;
+    uint16_t fg = 0;
+    if (visible){
+      glyph = sprite.glyph(clock);
+      fg = sprite.flashing(clock) ? TB_WHITE : sprite.fg;
+    }
+    
+    bool changed = visible != sprite.drawn || (visible && (p != sprite.drawnPosition || glyph != sprite.drawnGlyph || fg != sprite.drawnFg));
+    if (changed){
+      if (sprite.drawn){
+        vec2i dc = toScreen(sprite.drawnPosition);
+        damage_.mark(dc.x, dc.y);
+      }
+      if (visible){
+        damage_.mark(sc.x, sc.y);
       }
     }
+    
+    sprite.drawn = visible;
+    sprite.drawnPosition = p;
+    sprite.drawnGlyph = glyph;
+    sprite.drawnFg = fg;
   }
 }
 
+void RenderSystem::renderGround(){
+  const recti& b = game_.worldBounds;
+  const Array2D<char>& tiles = game_.groundTiles();
+  
+  // The world on screen, tile rows line up with screen rows
+  // Terrain is the depth a reset leaves behind, so ground goes straight in
+  const vec2i tl = toScreen({b.left, b.top});
+  damage_.forEachRow([&](int y, int x0, int x1){
+    if (y < tl.y || y >= tl.y + b.height) return;
+    x0 = std::max(x0, tl.x);
+    x1 = std::min(x1, tl.x + b.width);
+    if (x0 >= x1) return;
+    frame_.putBase(x0, y, &tiles(x0 - tl.x, y - tl.y), x1 - x0, TB_WHITE, TB_BLACK);
+  });
+}
+
 void RenderSystem::renderOcean(){
-  const vec2i ws { game_.window.width(), game_.window.height() };
   const recti& b = game_.worldBounds;
+  const int w = damage_.width(), h = damage_.height();
   
-  // Maps a coordinate to a random int
-  auto hash = [&](vec2i p) -> size_t {
-    auto mod = [](int x, int m){ if (x >= 0) return x % m; else return m - 1 - (-x % m);};
-    int px = mod(p.x + tick_ / 32,  randomArray2D_.width());
-    int py = mod(p.y - tick_ / 256, randomArray2D_.height());
-    return randomArray2D_(px, py);
-  };
+  auto mod = [](int x, int m){ if (x >= 0) return x % m; else return m - 1 - (-x % m);};
+  const int shiftX = tick_ / 32, shiftY = -tick_ / 256;
   
-  // Main mass
-  for (int y = 0; y < ws.y; y++){
-    for(int x = 0; x < ws.x; x++){
-      vec2i p = game_.worldCoord({x, y});
-      if (game_.onScreen(p) && !b.contains(p)){
-        char c = hash(p) % 16 == 0 ? '~' : ' ';
-        game_.window.set(x, y, c, TB_WHITE, TB_BLUE);
+  // Main mass, copied a pattern row at a time
+  const vec2i tl = toScreen({b.left, b.top});
+  const int wx0 = tl.x, wx1 = tl.x + b.width, wy0 = tl.y, wy1 = tl.y + b.height;
+  auto copyMass = [&](int y, int x0, int x1){
+    const Cell* row = &oceanPattern_(0, mod(lastOrigin_.y - y + shiftY, oceanPattern_.height()));
+    const int pw = oceanPattern_.width();
+    auto copy = [&](int x0, int x1){
+      int px = mod(lastOrigin_.x + x0 + shiftX, pw);
+      for (int x = x0; x < x1;){
+        int n = std::min(x1 - x, pw - px);
+        frame_.putRow(x, y, row + px, n, RenderDepth::Ocean);
+        x += n;
+        px = 0;
       }
+    };
+    // mod() runs one cell behind for negatives, so the pattern restarts at zero
+    int zero = std::max(x0, std::min(x1, x0 - (lastOrigin_.x + x0 + shiftX)));
+    copy(x0, zero);
+    copy(zero, x1);
+  };
+  damage_.forEachRow([&](int y, int x0, int x1){
+    if (y < wy0 || y >= wy1){
+      copyMass(y, x0, x1);
     }
-  }
+    else {
+      copyMass(y, x0, std::min(x1, wx0));
+      copyMass(y, std::max(x0, wx1), x1);
+    }
+  });
 
-  // Edges
-  for (bool fg: {false, true}){
-    int tick = fg ? tick_ + 50 : tick_;
-    
-    for (int yEdge: {-1, 1}){
-      int y = (yEdge == -1) ? (b.top - b.height + 1) : b.top;
-      for (int x = b.left; x < b.left + b.width; x++){
-        double mag = cos(tick * 0.03);
-        int depth = 1 + (int) (2 + 2 * mag * sin(tick * 0.01 + x * 0.1));
-        for (int dy = 0; dy < depth; dy++){
-          vec2i p {x, y - dy * yEdge};
-          vec2i sc = game_.screenCoord(p);
-          if (game_.onScreen(p)){
-            if (fg){
-              char c = (dy == depth-1) ? '~' : hash(p) % 4 == 0 ? '~' : ' ';
-              game_.window.set(sc.x, sc.y, c, TB_WHITE, TB_BLUE);
-            }
-            else {
-              game_.window.set(sc.x, sc.y, '~', TB_BLUE, TB_BLACK);
-            }
-          }
-        }
+  // Edges, from the wave tables built for this tick
+  auto edge = [&](int pass, vec2i p, int d, int depth){
+    vec2i sc = toScreen(p);
+    if (sc.x < 0 || sc.y < 0 || sc.x >= w || sc.y >= h || !damage_.dirty(sc.x, sc.y)) return;
+    if (pass == 1){
+      int r = randomArray2D_(mod(p.x + shiftX, randomArray2D_.width()), mod(p.y + shiftY, randomArray2D_.height()));
+      char c = (d == depth-1) ? '~' : r % 4 == 0 ? '~' : ' ';
+      frame_.put(sc.x, sc.y, Cell {(uint32_t) c, TB_WHITE, TB_BLUE}, RenderDepth::Ocean);
+    }
+    else {
+      frame_.put(sc.x, sc.y, Cell {'~', TB_BLUE, TB_BLACK}, RenderDepth::Ocean);
+    }
+  };
+  
+  const int bottom = b.top - b.height + 1, right = b.left + b.width - 1;
+  for (int pass = 0; pass < 2; pass++){
+    for (int i = 0; i < b.width; i++){
+      int x = b.left + i, depth = waveX_[pass][i];
+      for (int d = 0; d < depth; d++){
+        edge(pass, {x, bottom + d}, d, depth);
+        edge(pass, {x, b.top - d}, d, depth);
       }
     }
-    
-    for (int xEdge: {-1, 1}){
-      int x = (xEdge == -1) ? b.left : (b.left + b.width - 1);
-      for (int y = b.top - b.height + 1; y <= b.top; y++){
-        double mag = cos(tick * 0.03);
-        int depth = 1 + (int) (2 + 2 * mag * sin(tick * 0.01 + y * 0.1));
-        for (int dx = 0; dx < depth; dx++){
-          vec2i p {x - dx * xEdge, y };
-          vec2i sc = game_.screenCoord(p);
-          if (game_.onScreen(p)){
-            if (fg){
-              char c = (dx == depth-1) ? '~' : hash(p) % 4 == 0 ? '~' : ' ';
-              game_.window.set(sc.x, sc.y, c, TB_WHITE, TB_BLUE);
-            }
-            else {
-              game_.window.set(sc.x, sc.y, '~', TB_BLUE, TB_BLACK);
-            }
-          }
-        }
+    for (int i = 0; i < b.height; i++){
+      int y = bottom + i, depth = waveY_[pass][i];
+      for (int d = 0; d < depth; d++){
+        edge(pass, {b.left + d, y}, d, depth);
+        edge(pass, {right - d, y}, d, depth);
       }
     }
   }
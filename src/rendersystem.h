@@ -1,7 +1,9 @@
 #ifndef rendersystem_hpp
 #define rendersystem_hpp
 
+#include "damage.h"
 #include "entity.h"
+#include "framebuffer.h"
 #include "system.h"
 #include "termbox.h"
 #include "util.h"
@@ -15,6 +17,27 @@ enum class RenderLayer {
   MobAbove,
 };
 
+// Compositing depths, terrain at the bottom and the ocean over ground sprites
+namespace RenderDepth {
+  const uint8_t Terrain = 0;
+  const uint8_t Ocean   = 3;
+  inline uint8_t of(RenderLayer layer){
+    switch (layer){
+      default:
+      case RenderLayer::Ground:      return 1;
+      case RenderLayer::GroundCover: return 2;
+      case RenderLayer::Particles:   return 4;
+      case RenderLayer::MobBelow:    return 5;
+      case RenderLayer::Mob:         return 6;
+      case RenderLayer::MobAbove:    return 7;
+    }
+  }
+}
+
+// Sprites animate on a clock that steps once every few world ticks
+const int AnimTicks = 3;
+inline int animClock(int worldTick){ return worldTick / AnimTicks; }
+
 class Sprite: public Component {
 public:
   vec2i position {0, 0};
@@ -24,23 +47,41 @@ public:
   uint16_t fg = TB_WHITE;
   uint16_t bg = TB_BLACK;
   
-  // Animation
+  // Animation, worked out from the clock when drawn
   std::string frames {};
   bool animated    = false;
-  int frame        = 0;
-  int frameRate    = 1;
-  int frameCounter = 0;
+  int frame        = 0; // first frame, or the only one if not animated
+  int frameRate    = 1; // clock steps per frame
+  int animPhase    = 0;
   
   // Effects
-  int flashTimer   = 0;
+  int flashEnd     = 0; // clock step the flash ends on
+  
+  // What was last drawn, for damage tracking
+  bool drawn = false;
+  vec2i drawnPosition {0, 0};
+  char drawnGlyph = 0;
+  uint16_t drawnFg = 0;
   
   Sprite() = default;
-  Sprite(std::string frames, bool animated, int frameRate, uint16_t fg, uint16_t bg, vec2i position, RenderLayer layer):frames(frames), position(position), animated(animated), frameRate(frameRate), fg(fg), bg(bg), renderLayer(layer) {
+  Sprite(std::string frames, bool animated, int frameRate, uint16_t fg, uint16_t bg, vec2i position, RenderLayer layer, int clock):frames(frames), position(position), animated(animated), frameRate(frameRate), fg(fg), bg(bg), renderLayer(layer) {
     if (animated){
-      frame = randInt(0, 1);
-      frameCounter = randInt(0, frameRate);
+      auto& r = rng(RngStream::Render);
+      frame = randInt(r, 0, 1);
+      // The first frame change comes after 1 to frameRate steps
+      int counter = randInt(r, 0, frameRate);
+      animPhase = std::max(frameRate, 1) - std::max(1, frameRate - counter) - clock;
     }
   }
+  
+  char glyph(int clock) const {
+    if (!animated || frames.empty()) return frames[frame];
+    int steps = (clock + animPhase) / std::max(frameRate, 1);
+    return frames[(frame + steps) % frames.size()];
+  }
+  
+  bool flashing(int clock) const { return clock < flashEnd; }
+  void flash(int clock, int steps){ flashEnd = clock + steps; }
 };
 
 class Game;
@@ -48,18 +89,50 @@ class RenderSystem: public System {
 public:
   RenderSystem(Game& game);
   void update() final;
-  void handleEvent(const EvAny&) final {}
+  void handleEvent(const EvAny&) final;
 
+  // Only damaged cells are recomposed, the window keeps the rest from the last frame
   void render();
   
+  // Rows outside [top, bottom) are covered by an overlay and never scrolled
+  void setScrollRegion(int top, int bottom);
+  
+  void markDirty(vec2i worldCoord); // applied at the next render, after any camera move; off-screen cells are dropped
+  DamageTracker& damage() { return damage_; }
+  int cellsEmitted() const { return cellsEmitted_; } // window writes last frame
+  void setFullRedraw(bool full) { fullRedraw_ = full; } // damage everything every frame, to check the tracking against
+  
 protected:
+  void trackCamera();
+  void trackDirty();
+  void trackOcean();
+  void trackSprites();
+  
   void renderGround();
   void renderOcean();
+  void renderSprites();
+  void present();
+  
+  // World to screen is a translation with a y-flip, fixed once the camera is tracked
+  vec2i toScreen(vec2i p) const { return {p.x - lastOrigin_.x, lastOrigin_.y - p.y}; }
   
 protected:
   Game& game_;
   int32_t tick_ = 0;
   Array2D<int32_t> randomArray2D_;
+  Array2D<Cell> oceanPattern_; // randomArray2D_ as ocean mass cells
+  std::vector<uint8_t> waveX_[2]; // wave depth along the top and bottom edges, per pass
+  std::vector<uint8_t> waveY_[2]; // and along the left and right edges
+  
+  DamageTracker damage_;
+  FrameBuffer frame_;
+  int cellsEmitted_ = 0;
+  std::vector<vec2i> dirtyWorld_ {};
+  vec2i lastOrigin_ {0, 0};    // world coord of the top-left screen cell
+  int scrollTop_ = 0;
+  int scrollBottom_ = INT_MAX;
+  bool fullRedraw_ = false;
+  int32_t lastOceanTick_ = -1;
 };
 
 #endif /* rendersystem_hpp */
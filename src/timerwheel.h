@@ -0,0 +1,94 @@
+#ifndef timerwheel_hpp
+#define timerwheel_hpp
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// hierarchical timer wheel keyed on an expiry tick
+// each level has 64 slots covering 64x the span of the level below;
+// timers are cascaded down a level as the wheel turns, so advancing
+// costs O(expiring timers) plus an occasional cascade
+template <typename T>
+class TimerWheel {
+public:
+  static const int SlotBits = 6;
+  static const int Slots = 1 << SlotBits;
+  static const int Levels = 4; // covers 2^24 ticks, beyond that timers wait in overflow
+
+  explicit TimerWheel(uint32_t now = 0):now_(now){}
+
+  // expiry ticks that have already passed fire on the next advance()
+  void schedule(uint32_t expiry, T value){
+    if (expiry <= now_) expiry = now_ + 1;
+    place(Timer {expiry, std::move(value)});
+    size_++;
+  }
+
+  // processes every tick up to and including now, calling expire(value) for each timer due
+  template <typename F>
+  void advance(uint32_t now, F&& expire){
+    while (now_ < now){
+      now_++;
+
+      if ((now_ & lowMask(Levels)) == 0){
+        auto overflow = std::move(overflow_);
+        overflow_.clear();
+        for (auto& timer: overflow) place(std::move(timer));
+      }
+
+      // higher levels first, as they can cascade into the lower slots
+      for (int level = Levels - 1; level >= 1; level--){
+        if ((now_ & lowMask(level)) == 0){
+          auto& slot = slots_[level][(now_ >> (SlotBits * level)) & (Slots - 1)];
+          auto timers = std::move(slot);
+          slot.clear();
+          for (auto& timer: timers) place(std::move(timer));
+        }
+      }
+
+      auto& slot = slots_[0][now_ & (Slots - 1)];
+      if (!slot.empty()){
+        auto timers = std::move(slot);
+        slot.clear();
+        size_ -= timers.size();
+        for (auto& timer: timers) expire(timer.value);
+      }
+    }
+  }
+
+  uint32_t now() const { return now_; }
+  size_t size() const { return size_; }
+
+protected:
+  struct Timer {
+    uint32_t expiry;
+    T value;
+  };
+
+  static constexpr uint32_t lowMask(int level){
+    return (uint32_t(1) << (SlotBits * level)) - 1;
+  }
+
+  // a timer lives on the lowest level whose higher bits match the current tick
+  void place(Timer timer){
+    for (int level = 0; level < Levels; level++){
+      const int shift = SlotBits * (level + 1);
+      if ((timer.expiry >> shift) == (now_ >> shift)){
+        slots_[level][(timer.expiry >> (SlotBits * level)) & (Slots - 1)].push_back(std::move(timer));
+        return;
+      }
+    }
+    overflow_.push_back(std::move(timer));
+  }
+
+protected:
+  std::array<std::array<std::vector<Timer>, Slots>, Levels> slots_ {};
+  std::vector<Timer> overflow_ {};
+  uint32_t now_ = 0;
+  size_t size_ = 0;
+};
+
+#endif /* timerwheel_hpp */
@@ -0,0 +1,79 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <iostream>
+
+bool Trace::enabled_ = false;
+std::vector<Trace::Event> Trace::events_ {};
+std::atomic<uint64_t> Trace::next_ {0};
+volatile std::sig_atomic_t Trace::flushRequested_ = 0;
+std::string Trace::path_ {};
+std::string Trace::lastPath_ {};
+int Trace::files_ = 0;
+int64_t Trace::epoch_ = 0;
+
+bool Trace::start(const std::string& path, size_t capacity){
+  stop();
+  
+  size_t size = 1;
+  while (size < capacity) size <<= 1;
+  events_.assign(size, Event {nullptr, 0, 0, 0});
+  next_ = 0;
+  path_ = path;
+  files_ = 0;
+  epoch_ = now();
+  enabled_ = true;
+  return true;
+}
+
+void Trace::stop(){
+  if (!enabled_) return;
+  flush();
+  enabled_ = false;
+  events_.clear();
+  events_.shrink_to_fit();
+}
+
+void Trace::update(){
+  if (!flushRequested_) return;
+  flushRequested_ = 0;
+  if (enabled_) flush();
+}
+
+bool Trace::flush(){
+  if (!enabled_) return false;
+  
+  // The first file takes the path as given, later ones are numbered: trace.json, trace-2.json, ...
+  std::string path = path_;
+  if (++files_ > 1){
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+    path.insert(dot, "-" + std::to_string(files_));
+  }
+  
+  FILE* out = fopen(path.c_str(), "w");
+  if (!out){
+    std::cerr << "can't write trace to " << path << "\n";
+    return false;
+  }
+  
+  uint64_t end = next_.load(std::memory_order_relaxed);
+  uint64_t begin = end > events_.size() ? end - events_.size() : 0;
+  
+  // Timestamps are microseconds, from when tracing started
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (uint64_t i = begin; i < end; i++){
+    const Event& ev = events_[i & (events_.size() - 1)];
+    fprintf(out, "{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f", ev.name, ev.phase, (ev.start - epoch_) / 1e3);
+    if (ev.phase == 'X') fprintf(out, ", \"dur\": %.3f}", ev.duration / 1e3);
+    else fprintf(out, ", \"s\": \"t\"}");
+    fprintf(out, i + 1 < end ? ",\n" : "\n");
+  }
+  fprintf(out, "]}\n");
+  fclose(out);
+  
+  next_ = 0;
+  lastPath_ = path;
+  return true;
+}
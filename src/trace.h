@@ -0,0 +1,70 @@
+#ifndef trace_hpp
+#define trace_hpp
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Event trace in the Chrome trace format (chrome://tracing, ui.perfetto.dev)
+// Profile zones are recorded as spans and TRACE_INSTANT marks points in time.
+// Events go into a ring allocated when tracing starts, so recording is a slot
+// claim and a few stores; when it wraps the oldest events are overwritten. The
+// ring is written out and emptied by flush(), on exit, or at the next frame after
+// requestFlush() (e.g. from a SIGUSR1 handler).
+class Trace {
+public:
+  static const size_t DefaultCapacity = 1 << 18; // events, a power of two
+
+  static bool start(const std::string& path, size_t capacity = DefaultCapacity);
+  static void stop(); // writes what's left
+  static bool enabled() { return enabled_; }
+
+  static int64_t now(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  static void span(const char* name, int64_t start, int64_t duration){ record(name, 'X', start, duration); }
+  static void instant(const char* name){ if (enabled_) record(name, 'i', now(), 0); }
+
+  static void requestFlush(){ flushRequested_ = 1; } // async-signal-safe
+  static void update(); // once per frame, flushes if asked to
+  static bool flush();  // writes the ring to the next file, returns false on failure
+  static const std::string& lastPath() { return lastPath_; }
+
+protected:
+  struct Event {
+    const char* name;
+    int64_t start;    // ns, steady clock
+    int64_t duration; // ns, spans only
+    char phase;
+  };
+
+  static void record(const char* name, char phase, int64_t start, int64_t duration){
+    // A slot is claimed with one atomic add, no lock is taken
+    uint64_t i = next_.fetch_add(1, std::memory_order_relaxed);
+    events_[i & (events_.size() - 1)] = Event {name, start, duration, phase};
+  }
+
+protected:
+  static bool enabled_;
+  static std::vector<Event> events_;
+  static std::atomic<uint64_t> next_;
+  static volatile std::sig_atomic_t flushRequested_;
+
+  static std::string path_;
+  static std::string lastPath_;
+  static int files_;
+  static int64_t epoch_;
+};
+
+#ifdef NO_PROFILER
+#define TRACE_INSTANT(name)
+#else
+#define TRACE_INSTANT(name) Trace::instant(name)
+#endif
+
+#endif /* trace_hpp */
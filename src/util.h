@@ -1,14 +1,19 @@
 #ifndef util_hpp
 #define util_hpp
 
+#include "random.h"
+
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cassert>
+#include <climits>
+#include <cstdlib>
 #include <initializer_list>
-#include <random>
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 // reference to an entity or component
 struct ident {
@@ -282,8 +287,28 @@ public:
     return p.x >= 0 && p.x < width_ && p.y >=0 && p.y < height_;
   }
   
+  // Moves the contents of rows [top, bottom) by (dx, dy), clipped to those rows
+  // Cells that nothing moves into keep their old values
+  void shift(int top, int bottom, int dx, int dy){
+    top = std::max(top, 0);
+    bottom = std::min(bottom, height_);
+    const int w = width_ - std::abs(dx);
+    if (w <= 0 || bottom - top <= std::abs(dy)) return;
+    
+    const int srcX = std::max(-dx, 0), dstX = std::max(dx, 0);
+    auto moveRow = [&](int y){
+      T* src = &data_[srcX + (y - dy) * width_];
+      T* dst = &data_[dstX + y * width_];
+      if (dst < src) std::copy(src, src + w, dst);
+      else std::copy_backward(src, src + w, dst + w);
+    };
+    if (dy > 0) for (int y = bottom - 1; y >= top + dy; y--) moveRow(y);
+    else for (int y = top; y < bottom + dy; y++) moveRow(y);
+  }
+  
   // Raw data access
   std::vector<T>& data() { return data_; }
+  const std::vector<T>& data() const { return data_; }
   
 private:
   T nullVal_ {};
@@ -294,31 +319,98 @@ private:
 
 // Random number generation
 
-inline std::default_random_engine& engine(){
-  static std::default_random_engine engine_;
-  return engine_;
+inline int32_t randInt(Rng& rng, int32_t from, int32_t to){
+  return rng.range(from, to);
 }
 
 inline int32_t randInt(int32_t from, int32_t to){
-  return std::uniform_int_distribution<>(from, to)(engine());
+  return randInt(rng(), from, to);
+}
+
+inline double random(Rng& rng, double from = 0.0, double to = 1.0){
+  return rng.uniform(from, to);
 }
 
 inline double random(double from = 0.0, double to = 1.0){
-  return std::uniform_real_distribution<>(from, to)(engine());
+  return random(rng(), from, to);
+}
+
+inline vec2i randVec2i(Rng& rng, vec2i from, vec2i to){
+  return { randInt(rng, from.x, to.x), randInt(rng, from.y, to.y) };
 }
 
 inline vec2i randVec2i(vec2i from, vec2i to){
-  return { randInt(from.x, to.x), randInt(from.y, to.y) };
+  return randVec2i(rng(), from, to);
+}
+
+template <typename T>
+T choose(Rng& rng, const std::vector<T>& values){
+  return values[rng.bounded((uint32_t) values.size())];
+}
+
+template <typename T>
+T choose(Rng& rng, std::initializer_list<T> values){
+  return *(values.begin() + rng.bounded((uint32_t) values.size()));
+}
+
+// Bernoulli process sampler
+// rather than rolling a die per element, draws the gap to the next success
+// from a geometric distribution, so rare events cost one draw per success
+class BernoulliSkip {
+public:
+  BernoulliSkip(Rng& rng, double p):rng_(rng), p_(p), invLogQ_(p > 0 && p < 1 ? 1.0 / std::log1p(-p) : 0.0){}
+  
+  // number of failures before the next success
+  int64_t next(){
+    if (p_ >= 1) return 0;
+    if (p_ <= 0) return INT64_MAX;
+    double u = 1.0 - rng_.uniform(); // (0, 1]
+    double gap = std::floor(std::log(u) * invLogQ_);
+    return gap < (double) INT64_MAX ? (int64_t) gap : INT64_MAX;
+  }
+  
+private:
+  Rng& rng_;
+  double p_;
+  double invLogQ_;
+};
+
+// calls f(i) for each i in [0, n) independently with probability p
+// a skip costs a log, so for p > 0.5 one roll per element is cheaper (see bench "sampling")
+template <typename F>
+void sampleRange(Rng& rng, int64_t n, double p, F&& f){
+  if (p > 0.5){
+    for (int64_t i = 0; i < n; i++){
+      if (rng.uniform() < p) f(i);
+    }
+  }
+  else {
+    BernoulliSkip skip {rng, p};
+    for (int64_t i = skip.next(); i < n; ){
+      f(i);
+      int64_t gap = skip.next();
+      if (gap >= n) break;
+      i += 1 + gap;
+    }
+  }
+}
+
+// calls f(x, y) for each cell of a width x height grid independently with probability p
+template <typename F>
+void sampleGrid(Rng& rng, int width, int height, double p, F&& f){
+  sampleRange(rng, (int64_t) width * height, p, [&](int64_t i){
+    f((int) (i % width), (int) (i / width));
+  });
 }
 
 template <typename T>
 T choose(const std::vector<T>& values){
-  return values[randInt(0, values.size()-1)];
+  return choose(rng(), values);
 }
 
 template <typename T>
 T choose(std::initializer_list<T> values){
-  return *(values.begin() + randInt(0, (int) values.size()-1));
+  return choose(rng(), values);
 }
 
 #endif
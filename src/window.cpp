@@ -1,46 +1,95 @@
 #include "window.h"
+#include "recorder.h"
 #include "termbox.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <thread>
 
-#ifdef NO_WINDOW // Null window (for testing)
+// Clips a span of cells to a width x height window, returns false if nothing is left
+static bool clipRow(int width, int height, int y, int& x0, const Cell*& cells, int& count){
+  if (y < 0 || y >= height) return false;
+  if (x0 < 0){
+    cells -= x0;
+    count += x0;
+    x0 = 0;
+  }
+  count = std::min(count, width - x0);
+  return count > 0;
+}
 
-#include <iostream>
-#include <thread>
+#ifdef NO_WINDOW // Off-screen window (for testing and benchmarks)
+
+Window::Window(){
+  setSize(256, 128);
+}
 
-Window::Window(){}
 Window::~Window(){}
 
-int32_t Window::width() const  { return 256; }
-int32_t Window::height() const { return 128; }
-  
 bool Window::handleEvents() {
   events_.clear();
   static int i = 0;
   static const std::vector<WindowEvent> evs {WindowEvent::ArrowUp,  WindowEvent::ArrowLeft, WindowEvent::ArrowDown, WindowEvent::ArrowRight};
-  events_.push_back(evs[(i++)%4]);
+  events_.push_back({evs[(i++)%4], stampNow()});
   return true;
 }
+
+void Window::waitEvents(std::chrono::microseconds timeout) {
+  std::this_thread::sleep_for(timeout);
+}
+
+bool Window::render() {
+  if (recorder_) recorder_->frame(cells_.data().data(), width_, height_);
+  
+  frames_++;
+  if (!hashLog_ && !dump_.is_open()) return true;
   
-const std::vector<WindowEvent>& Window::events() const { return events_; }
-
-void Window::render() {
-  std::cout << "Window::render()\n";
-  using namespace std::chrono_literals;
-  const auto delayPerFrame = 15ms;
-  if (delayPerFrame != 0ms){
-    std::this_thread::sleep_for(delayPerFrame);
+  uint64_t hash = frameHash();
+  if (hashLog_){
+    *hashLog_ << "frame " << frames_ << " hash " << std::hex << hash << std::dec << "\n";
   }
+  if (dump_.is_open()){
+    dump_ << "frame " << frames_ << " hash " << std::hex << hash << std::dec << "\n";
+    std::string row;
+    for (int y = 0; y < height_; y++){
+      row.clear();
+      for (int x = 0; x < width_; x++){
+        uint32_t ch = cells_(x, y).ch;
+        row += (ch >= 32 && ch < 127) ? (char) ch : ch == 0 ? ' ' : '?';
+      }
+      dump_ << row << "\n";
+    }
+  }
+  return true;
 }
 
-void Window::clear() {}
+void Window::setDumpFile(const std::string& path){
+  dump_.open(path, std::ios::out | std::ios::trunc);
+  if (!dump_){
+    std::cerr << "can't open " << path << " for writing\n";
+  }
+}
 
-void Window::set(int x, int y, char c, uint16_t fg, uint16_t bg) {}
+void Window::setHashLog(std::ostream* out){
+  hashLog_ = out;
+}
+
+uint64_t Window::frameHash() const {
+  // Byte by byte over each cell's glyph and both colours, packed the same way on any host
+  uint64_t hash = 14695981039346656037ull;
+  for (const Cell& cell: cells_.data()){
+    uint64_t word = cell.ch | (uint64_t) cell.fg << 32 | (uint64_t) cell.bg << 48;
+    for (int i = 0; i < 8; i++){
+      hash ^= (word >> (i * 8)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
 
 #elif defined(__EMSCRIPTEN__) // Emscripten Window
 
-#include <array>
 #include <iostream>
 #include <string>
 
@@ -62,64 +111,32 @@ bool Window::handleEvents(){
   return true;
 }
 
+void Window::waitEvents(std::chrono::microseconds){
+  // The browser calls back with input, there's nothing to wait on
+}
+
 EM_BOOL Window::emsKeyDownCallback(int eventType, const EmscriptenKeyboardEvent* e, void* userData) {
   using namespace std::string_literals;
-  if      (e->key == "ArrowDown"s)  eventsBuffer_.push_back(WindowEvent::ArrowDown);
-  else if (e->key == "ArrowUp"s)    eventsBuffer_.push_back(WindowEvent::ArrowUp);
-  else if (e->key == "ArrowLeft"s)  eventsBuffer_.push_back(WindowEvent::ArrowLeft);
-  else if (e->key == "ArrowRight"s) eventsBuffer_.push_back(WindowEvent::ArrowRight);
+  int64_t stamp = stampNow();
+  if      (e->key == "ArrowDown"s)  eventsBuffer_.push_back({WindowEvent::ArrowDown, stamp});
+  else if (e->key == "ArrowUp"s)    eventsBuffer_.push_back({WindowEvent::ArrowUp, stamp});
+  else if (e->key == "ArrowLeft"s)  eventsBuffer_.push_back({WindowEvent::ArrowLeft, stamp});
+  else if (e->key == "ArrowRight"s) eventsBuffer_.push_back({WindowEvent::ArrowRight, stamp});
+  else if (e->key == "l"s || e->key == "L"s) eventsBuffer_.push_back({WindowEvent::ShowLatency, stamp});
+  else if (e->key == "p"s || e->key == "P"s) eventsBuffer_.push_back({WindowEvent::ToggleProfiler, stamp});
   return false;
 }
 
-void Window::setSize(int w, int h){
-  width_  = w;
-  height_ = h;
-}
-
-void Window::render(){
-  EM_ASM(Module.flush());
-}
-
-void Window::clear(){
-  EM_ASM(Module.clear());
-}
-
-void Window::set(int x, int y, char ch, uint16_t fg_, uint16_t bg_){
-  using rgb = std::array<int, 3>;
-
-  auto map_colour = [](uint16_t col) -> rgb {
-    switch (col){
-      default:
-      case TB_DEFAULT: return {255, 255, 255};
-      case TB_BLACK: return {0, 0, 0};
-      case TB_RED: return {255, 0, 0};
-      case TB_GREEN: return {0, 255, 0};
-      case TB_YELLOW: return {255, 255, 0};
-      case TB_BLUE: return {0, 0, 255};
-      case TB_MAGENTA: return {255, 0, 255};
-      case TB_CYAN: return {0, 255, 255};
-      case TB_WHITE: return {255, 255, 255};
-    }
-  };
-
-  rgb fg = map_colour(fg_);
-  rgb bg = map_colour(bg_);
-
-  int i = x;
-  int j = y;
-  EM_ASM({Module.set_char_and_colour($0, $1, String.fromCharCode($2), $3, $4, $5, $6, $7, $8)}, i, j, ch, fg[0], fg[1], fg[2], bg[0], bg[1], bg[2]);
-}
-
-int32_t Window::width() const {
-  return width_;
-}
-
-int32_t Window::height() const {
-  return height_;
+bool Window::render(){
+  // The only crossing per frame, JS diffs the cells against what it last drew
+  EM_ASM({Module.present($0, $1, $2)}, cells_.data().data(), width_, height_);
+  return true;
 }
 
 #else // Terminal
 
+#include <poll.h>
+
 Window::Window(){
   int code = tb_init();
   if (code < 0) {
@@ -139,46 +156,62 @@ Window::~Window(){
 bool Window::handleEvents(){
   events_.clear();
   
+  // Everything that's arrived since the last frame
   struct tb_event ev;
-  if (tb_peek_event(&ev, 10)) {
+  // Input that woke waitEvents is stamped from then, not from when it's drained
+  while (tb_peek_event(&ev, 0) > 0){
+    int64_t stamp = inputSince_ ? inputSince_ : stampNow();
     switch (ev.type) {
       case TB_EVENT_KEY:
         switch (ev.key) {
           case TB_KEY_ESC:
             return false;
-            break;
           case TB_KEY_ARROW_LEFT:
-            events_.push_back(WindowEvent::ArrowLeft);
+            events_.push_back({WindowEvent::ArrowLeft, stamp});
             break;
           case TB_KEY_ARROW_RIGHT:
-            events_.push_back(WindowEvent::ArrowRight);
+            events_.push_back({WindowEvent::ArrowRight, stamp});
             break;
           case TB_KEY_ARROW_UP:
-            events_.push_back(WindowEvent::ArrowUp);
+            events_.push_back({WindowEvent::ArrowUp, stamp});
             break;
           case TB_KEY_ARROW_DOWN:
-            events_.push_back(WindowEvent::ArrowDown);
+            events_.push_back({WindowEvent::ArrowDown, stamp});
+            break;
+          default:
+            if (ev.ch == 'l' || ev.ch == 'L') events_.push_back({WindowEvent::ShowLatency, stamp});
+            else if (ev.ch == 'p' || ev.ch == 'P') events_.push_back({WindowEvent::ToggleProfiler, stamp});
+            else if (ev.ch == 't' || ev.ch == 'T') events_.push_back({WindowEvent::WriteTrace, stamp});
             break;
         }
         break;
       case TB_EVENT_RESIZE:
-        // draw_all();
+        // Take the new size now, so this frame is drawn at it
+        tb_clear();
+        events_.push_back({WindowEvent::Resize, stamp});
         break;
     }
   }
+  inputSince_ = 0;
   
   return true;
 }
 
-void Window::render(){
-  using namespace std::chrono_literals;
-  const auto delayPerFrame = 15ms;
+void Window::waitEvents(std::chrono::microseconds timeout){
+  if (timeout.count() <= 0) return;
   
-  tb_present();
+  int input = -1, resize = -1;
+  tb_get_fds(&input, &resize);
+  struct pollfd fds[2] = {{input, POLLIN, 0}, {resize, POLLIN, 0}};
   
-  if (delayPerFrame != 0ms){
-    std::this_thread::sleep_for(delayPerFrame);
-  }
+  // Rounded up, waking early would only mean waiting again
+  int ms = (int) ((timeout.count() + 999) / 1000);
+  if (poll(fds, 2, ms) > 0 && !inputSince_) inputSince_ = stampNow();
+}
+
+bool Window::render(){
+  if (recorder_) recorder_->frame(reinterpret_cast<const Cell*>(tb_cell_buffer()), tb_width(), tb_height());
+  return tb_present() == 0;
 }
 
 void Window::clear(){
@@ -189,6 +222,19 @@ void Window::set(int x, int y, char c, uint16_t fg, uint16_t bg){
   tb_change_cell(x, y, c, fg, bg);
 }
 
+void Window::setRow(int y, int x0, const Cell* cells, int count){
+  static_assert(sizeof(Cell) == sizeof(tb_cell), "Cell must match tb_cell");
+  if (!clipRow(tb_width(), tb_height(), y, x0, cells, count)) return;
+  
+  // Straight into termbox's back buffer
+  std::memcpy(tb_cell_buffer() + y * tb_width() + x0, cells, count * sizeof(Cell));
+  tb_mark_rows(y, y + 1);
+}
+
+bool Window::scroll(int top, int bottom, int dx, int dy){
+  return tb_scroll(top, bottom, dx, dy) == 0;
+}
+
 int32_t Window::width() const {
   return tb_width();
 }
@@ -198,3 +244,58 @@ int32_t Window::height() const {
 }
 
 #endif
+
+#if defined(NO_WINDOW) || defined(__EMSCRIPTEN__) // Cell buffer windows
+
+void Window::setSize(int w, int h){
+  width_  = w;
+  height_ = h;
+  cells_.resize(width_, height_);
+  clear();
+}
+
+void Window::clear(){
+  cells_.fill(Cell {' ', TB_WHITE, TB_BLACK});
+}
+
+void Window::set(int x, int y, char c, uint16_t fg, uint16_t bg){
+  if (!cells_.inBounds(x, y)) return;
+  cells_(x, y) = Cell {(uint32_t) (unsigned char) c, fg, bg};
+}
+
+void Window::setRow(int y, int x0, const Cell* cells, int count){
+  if (!clipRow(width_, height_, y, x0, cells, count)) return;
+  std::copy(cells, cells + count, &cells_(x0, y));
+}
+
+bool Window::scroll(int top, int bottom, int dx, int dy){
+  // Nothing else holds the screen (the canvas diffs cells itself), so moving the buffer is all there is to do
+  cells_.shift(top, bottom, dx, dy);
+  return true;
+}
+
+int32_t Window::width() const {
+  return width_;
+}
+
+int32_t Window::height() const {
+  return height_;
+}
+
+#endif
+
+// Common
+
+void Window::setRow(int y, int x0, const std::string& text, uint16_t fg, uint16_t bg){
+  rowScratch_.resize(text.size());
+  for (size_t i = 0; i < text.size(); i++){
+    rowScratch_[i] = Cell {(uint32_t) (unsigned char) text[i], fg, bg};
+  }
+  setRow(y, x0, rowScratch_.data(), (int) rowScratch_.size());
+}
+
+void Window::blit(int x, int y, int w, int h, const Cell* cells){
+  for (int j = 0; j < h; j++){
+    setRow(y + j, x, cells + j * w, w);
+  }
+}
@@ -1,15 +1,30 @@
 #ifndef window_hpp
 #define window_hpp
 
+#include "framebuffer.h"
+#include "latency.h"
 #include "termbox.h"
 #include "util.h"
 
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef NO_WINDOW
+#include <fstream>
+#include <ostream>
+#endif
+
 enum class WindowEvent {
   Unknown,
   ArrowUp,
   ArrowDown,
   ArrowLeft,
   ArrowRight,
+  Resize,     // everything on screen needs drawing again
+  ShowLatency,
+  ToggleProfiler,
+  WriteTrace,
 };
 
 inline std::string to_string(WindowEvent ev){
@@ -20,14 +35,26 @@ inline std::string to_string(WindowEvent ev){
     case WindowEvent::ArrowDown:  return "ArrowDown";
     case WindowEvent::ArrowLeft:  return "ArrowLeft";
     case WindowEvent::ArrowRight: return "ArrowRight";
+    case WindowEvent::Resize:     return "Resize";
+    case WindowEvent::ShowLatency: return "ShowLatency";
+    case WindowEvent::ToggleProfiler: return "ToggleProfiler";
+    case WindowEvent::WriteTrace: return "WriteTrace";
   }
 }
 
+// An event and when it was taken from the system, see stampNow()
+struct InputEvent {
+  WindowEvent type;
+  int64_t stamp;
+};
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
 #include <emscripten/html5.h>
 #endif
 
+class Recorder;
+
 class Window {
 public:
   Window();
@@ -35,25 +62,69 @@ public:
   int32_t width() const;
   int32_t height() const;
   
-  bool handleEvents(); // returns false on quit
-  const std::vector<WindowEvent>& events() const { return events_; }
-  void render();
+  bool handleEvents(); // takes everything pending without blocking, returns false on quit
+  void waitEvents(std::chrono::microseconds timeout); // until input arrives or the timeout passes
+  const std::vector<InputEvent>& events() const { return events_; }
+  bool render(); // false if the frame was dropped rather than shown
   
   void clear();
   void set(int x, int y, char c, uint16_t fg, uint16_t bg);
+  
+  // Bulk drawing, spans are clipped to the window
+  void setRow(int y, int x0, const Cell* cells, int count);
+  void setRow(int y, int x0, const std::string& text, uint16_t fg, uint16_t bg);
+  void blit(int x, int y, int w, int h, const Cell* cells); // w * h cells, rows top to bottom
+  
+  // Moves everything drawn in rows [top, bottom) by (dx, dy) without redrawing it
+  // Cells moved in from outside keep stale contents until drawn over
+  // Returns false if nothing was moved, and the screen must be redrawn in full
+  bool scroll(int top, int bottom, int dx, int dy);
+  
+  // Fed the whole screen on every render (terminal and off-screen windows)
+  void setRecorder(Recorder* recorder) { recorder_ = recorder; }
+
+#if defined(NO_WINDOW) || defined(__EMSCRIPTEN__)
+  void setSize(int width, int height);
+#endif
+
+#ifdef NO_WINDOW
+  // Off-screen output, so headless runs can check and time what gets drawn
+  void setDumpFile(const std::string& path); // appends every rendered frame as text
+  void setHashLog(std::ostream* out);        // writes "frame n hash" per rendered frame
+  uint64_t frameHash() const;                // FNV-1a of the current cells
+  int64_t frames() const { return frames_; } // rendered so far
+#endif
 
 #ifdef __EMSCRIPTEN__
   EM_BOOL emsKeyDownCallback(int eventType, const EmscriptenKeyboardEvent* e, void* userData);
-  void setSize(int width, int height);
 
 private:
-  std::vector<WindowEvent> eventsBuffer_;
+  std::vector<InputEvent> eventsBuffer_;
+#endif
+
+#if defined(NO_WINDOW) || defined(__EMSCRIPTEN__)
+private:
+  Array2D<Cell> cells_ {60, 60, Cell {' ', TB_WHITE, TB_BLACK}}; // whole screen, handed to JS on render in the browser
   int width_ {60};
   int height_ {60};
 #endif
 
+#ifdef NO_WINDOW
+private:
+  std::ofstream dump_;
+  std::ostream* hashLog_ = nullptr;
+  int64_t frames_ = 0;
+#endif
+
+#if !defined(NO_WINDOW) && !defined(__EMSCRIPTEN__)
+private:
+  int64_t inputSince_ = 0; // when waitEvents saw input that's not been taken yet
+#endif
+
 private:
-  std::vector<WindowEvent> events_;
+  std::vector<InputEvent> events_;
+  std::vector<Cell> rowScratch_;
+  Recorder* recorder_ = nullptr;
 };
 
 #endif 
\ No newline at end of file